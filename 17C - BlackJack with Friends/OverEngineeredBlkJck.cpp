@@ -8,240 +8,567 @@
 */
 
 #include <algorithm>
+#include <array>
+#include <cassert>
+#include <cctype>
+#include <atomic>
+#include <chrono>
+#include <cmath>
+#include <condition_variable>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
 #include <deque>
+#include <exception>
+#include <fstream>
 #include <functional>
 #include <iomanip>
 #include <iostream>
-#include <list>
 #include <map>
 #include <memory>
+#include <memory_resource>
+#include <mutex>
 #include <queue>
 #include <random>
 #include <set>
 #include <sstream>
-#include <stack>
 #include <string>
+#include <thread>
 #include <unordered_map>
 #include <utility>
+#include <vector>
 #include <iterator>
 
+//Profiles are kept in a memory mapped file where the platform has mmap.
+#if defined(__unix__) || defined(__APPLE__)
+#define BLKJCK_HAVE_MMAP
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+//The table server needs epoll, which only Linux has.
+#if defined(__linux__)
+#define BLKJCK_HAVE_EPOLL
+#include <arpa/inet.h>
+#include <cerrno>
+#include <csignal>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <sys/epoll.h>
+#include <sys/socket.h>
+#endif
+
 using namespace std;
 
+/*
+    debug builds count every heap allocation, per thread, by replacing the global operator new.
+    Game::playRound() uses it to assert that a table settled into its rounds never touches the heap.
+    release builds (NDEBUG) leave the allocator alone and allocationCount() is always 0.
+*/
+#ifndef NDEBUG
+#define BLKJCK_COUNT_ALLOCATIONS
+inline thread_local uint64_t t_allocations = 0;
+
+void* operator new(size_t size){
+    t_allocations++;
+    if (void* memory = malloc(size ? size : 1)){
+        return memory;
+    }
+    throw bad_alloc();
+}
+//Kept out of line, otherwise gcc inlines them and mistakes new/free for a mismatched pair.
+[[gnu::noinline]] void operator delete(void* memory) noexcept{
+    free(memory);
+}
+[[gnu::noinline]] void operator delete(void* memory, size_t) noexcept{
+    free(memory);
+}
+#endif
+
+//Heap allocations made on this thread so far.
+inline uint64_t allocationCount(){
+#ifdef BLKJCK_COUNT_ALLOCATIONS
+    return t_allocations;
+#else
+    return 0;
+#endif
+}
+
 //No more than a deck of cards per deck (obviously).
 const int MAXCARDS = 52;
+//Default cut card placement, as a fraction of the shoe dealt before reshuffling.
+const double DEFAULTPENETRATION = 0.75;
+const int NUMRANKS = 13;
+const int NUMSUITS = 4;
+
+/*
+    lookup tables for the packed card encoding. ranks are stored by index (0 = "2" up to 12 = "Ace"),
+    so the blackjack value of a card is a single array read instead of a string compare + stoi().
+    aces are listed as 11 here, Hand decides when they drop down to 1.
+*/
+constexpr int CARD_VALUES[NUMRANKS] = {2, 3, 4, 5, 6, 7, 8, 9, 10, 10, 10, 10, 11};
+constexpr const char* RANK_NAMES[NUMRANKS] = {"2", "3", "4", "5", "6", "7", "8", "9", "10", "Jack", "Queen", "King", "Ace"};
+constexpr const char* SUIT_NAMES[NUMSUITS] = {"HEARTS", "DIAMONDS", "CLUBS", "SPADES"};
+constexpr int ACE = NUMRANKS - 1;
 
 class Card {
 private:
 
-    string m_suit;
-    string m_rank;
-    bool m_faceUp;
+    /*
+        the whole card fits in one byte:
+        bits 0-3 = rank index, bits 4-5 = suit index, bit 6 = face up flag.
+        copying a card around the deck and hands is now just copying a byte.
+    */
+    static constexpr uint8_t RANK_MASK = 0x0F;
+    static constexpr uint8_t SUIT_SHIFT = 4;
+    static constexpr uint8_t SUIT_MASK = 0x30;
+    static constexpr uint8_t FACE_BIT = 0x40;
+
+    uint8_t m_bits;
 
 public:
     
-    Card() : m_suit(""), m_rank("") {}
+    Card() : m_bits(0) {}
 
-    Card(string decSuit, string decRank, bool setFace = true) : m_suit(decSuit), m_rank(decRank), m_faceUp(setFace) {}
+    Card(int decSuit, int decRank, bool setFace = true)
+        : m_bits(static_cast<uint8_t>((decRank & RANK_MASK) | ((decSuit << SUIT_SHIFT) & SUIT_MASK) | (setFace ? FACE_BIT : 0))) {}
     
-    // Getters
+    // Packed accessors, used by the game logic.
+    int rankIndex() const{
+        return m_bits & RANK_MASK;
+    }
+
+    int suitIndex() const{
+        return (m_bits & SUIT_MASK) >> SUIT_SHIFT;
+    }
+
+    int getValue() const{
+        return CARD_VALUES[rankIndex()];
+    }
+
+    bool isAce() const{
+        return rankIndex() == ACE;
+    }
+
+    // Display adapters, only for toString()/showHand() and the like.
     string getRank() const{
-        return m_rank;
+        return RANK_NAMES[rankIndex()];
     }
 
     string getSuit() const {
-        return m_suit;
+        return SUIT_NAMES[suitIndex()];
     }
 
     bool isFaceUp() const {
-        return m_faceUp;
+        return (m_bits & FACE_BIT) != 0;
     }
     // Setters
     void flip() {
-        if (m_faceUp) {
-            m_faceUp = false;
-        }
+        m_bits &= static_cast<uint8_t>(~FACE_BIT);
     }
 
+    //Face up flag doesn't count towards card identity.
     bool operator==(const Card& other) const {
-        if (m_rank == other.m_rank && m_suit == other.m_suit) {
-            return true;
-        }
-
-        else {
-            return false;
-        }
+        return (m_bits & (RANK_MASK | SUIT_MASK)) == (other.m_bits & (RANK_MASK | SUIT_MASK));
     }
 
     bool operator<(const Card& other) const {
-        if (m_rank < other.m_rank) {
-            return true;
-
-        }
-        else if (m_rank > other.m_rank){
-            return false;
+        if (rankIndex() != other.rankIndex()) {
+            return rankIndex() < other.rankIndex();
         }
         //If card ranks are the same, compare the suits.
-        return m_suit < other.m_suit;
+        return suitIndex() < other.suitIndex();
     }
     Card operator+(const Card& other) const {
         return Card();
     }
 };
 
+static_assert(sizeof(Card) == 1, "Card is meant to stay packed into a single byte");
+
+/*
+    what's left in a shoe, counted by blackjack value instead of by card. index 0 is the 2s up through
+    index 8 for everything worth 10, and index 9 for aces, so a card's index is just getValue() - 2.
+*/
+const int NUMVALUES = 10;
+using ShoeComposition = array<uint16_t, NUMVALUES>;
+
+inline int valueIndex(const Card& card){
+    return card.getValue() - 2;
+}
+inline int compositionSize(const ShoeComposition& shoe){
+    int total = 0;
+    for (uint16_t count : shoe){
+        total += count;
+    }
+    return total;
+}
+
+/*
+    a card counting system: the tag each value adds to the running count when it's seen, indexed like
+    ShoeComposition (2s first, aces last). balanced systems' tags sum to zero over a deck. unbalanced ones
+    (KO) start the count at pivot minus the shoe's total tags, so the count lands on pivot at the end of the shoe.
+*/
+struct CountSystem {
+    const char* name;
+    array<int8_t, NUMVALUES> tags;
+    int pivot;
+
+    constexpr int deckTotal() const{
+        int total = 0;
+        for (int v = 0; v < NUMVALUES; v++){
+            total += tags[v] * (v == 8 ? 16 : 4);
+        }
+        return total;
+    }
+};
+
+namespace counts {
+    //                                         2  3  4  5  6  7  8  9 10  A
+    constexpr CountSystem HILO   { "hilo",   {{ 1, 1, 1, 1, 1, 0, 0, 0,-1,-1 }}, 0 };
+    constexpr CountSystem KO     { "ko",     {{ 1, 1, 1, 1, 1, 1, 0, 0,-1,-1 }}, 4 };
+    constexpr CountSystem HIOPT2 { "hiopt2", {{ 1, 1, 2, 2, 1, 1, 0, 0,-2, 0 }}, 0 };
+    constexpr CountSystem OMEGA2 { "omega2", {{ 1, 1, 2, 2, 2, 1, 0,-1,-2, 0 }}, 0 };
+    constexpr CountSystem ZEN    { "zen",    {{ 1, 1, 2, 2, 2, 1, 0, 0,-2,-1 }}, 0 };
+
+    constexpr const CountSystem* ALL[] = { &HILO, &KO, &HIOPT2, &OMEGA2, &ZEN };
+
+    //Looks a system up by name, nullptr if there isn't one.
+    inline const CountSystem* find(const string& name){
+        for (const CountSystem* system : ALL){
+            if (name == system->name){
+                return system;
+            }
+        }
+        return nullptr;
+    }
+}
+
+static_assert(counts::HILO.deckTotal() == 0, "hi-lo is balanced");
+static_assert(counts::KO.deckTotal() == 4, "ko is unbalanced by +4 a deck");
+static_assert(counts::OMEGA2.deckTotal() == 0, "omega II is balanced");
+
+
+/*
+    thrown by Deck::deal() when a round has every card of the shoe out on the table, so there's
+    nothing left even after the discards go back in. the game calls the round off when it sees it.
+    no message string to build, so throwing it never allocates in the middle of a headless round.
+*/
+struct ShoeExhausted : exception {
+    const char* what() const noexcept override{
+        return "the shoe ran out of cards mid-round";
+    }
+};
+
+
 class Deck {
 private:
-    list<Card> cards;
-    stack<Card> discardPile;
+    /*
+        the shoe is one contiguous block of cards with a cursor. everything before m_next has
+        already been dealt, so dealing is just reading a card and bumping the cursor.
+    */
+    vector<Card> cards;
+    size_t m_next;
+    vector<Card> discardPile;
+
+    /*
+        the shoe can hold several 52 card decks. the cut card sits m_penetration of the way in,
+        once fewer than m_cutCardRemaining cards are left the shoe is due for a reshuffle.
+    */
+    int m_numDecks;
+    double m_penetration;
+    int m_cutCardRemaining;
+
+    //Each deck owns its generator, so separate tables (and threads) never share random state.
+    mt19937 m_rng;
+
+    /*
+        tallies kept up to date as cards move, so nothing has to walk the shoe to know what's in it.
+        m_rankRemaining counts the undealt cards of each rank, m_rankDiscarded what's sitting on the
+        discard pile waiting to go back in. m_remainingTags is the count system's tags summed over the
+        undealt cards, the running count is just what's been taken out of the full shoe's total.
+    */
+    array<uint16_t, NUMRANKS> m_rankRemaining;
+    array<uint16_t, NUMRANKS> m_rankDiscarded;
+    array<int8_t, NUMRANKS> m_rankTags;
+    CountSystem m_countSystem;
+    int m_remainingTags;
+    int m_discardedTags;
     
 public:
     // Constructor
-    Deck() {
+    Deck(int numDecks = 1, double penetration = DEFAULTPENETRATION)
+        : m_next(0), m_rng(random_device{}()), m_countSystem(counts::HILO) {
+        configure(numDecks, penetration);
+    }
+    // Deck operations
+
+    /*
+        (re)builds the shoe with numDecks fresh decks, unshuffled. the buffers are sized once here
+        for the whole shoe, so reshuffles later on never have to allocate.
+    */
+    void configure(int numDecks, double penetration = DEFAULTPENETRATION){
+        m_numDecks = max(numDecks, 1);
+        m_penetration = min(max(penetration, 0.0), 1.0);
 
-        //Storing suit and rank values into an array to then populate the list of Cards, with card objects. Forming a deck!
-        string suits[] = {"HEARTS", "DIAMONDS", "CLUBS", "SPADES"};
-        string ranks[] = {"2", "3", "4", "5", "6", "7", "8", "9", "10", "Jack", "Queen", "King", "Ace"};
+        int total = m_numDecks * MAXCARDS;
+        m_cutCardRemaining = total - static_cast<int>(total * m_penetration);
 
-        //Populate function goes here:
-        for (auto& iterSuits : suits) {
-            for (auto& iterRanks : ranks) {
-                cards.push_back(Card(iterSuits, iterRanks));
+        cards.clear();
+        discardPile.clear();
+        m_next = 0;
+        cards.reserve(total);
+        discardPile.reserve(total);
+
+        //Populate the shoe by suit and rank index, forming a deck (or several)!
+        for (int d = 0; d < m_numDecks; d++) {
+            for (int iterSuits = 0; iterSuits < NUMSUITS; iterSuits++) {
+                for (int iterRanks = 0; iterRanks < NUMRANKS; iterRanks++) {
+                    cards.push_back(Card(iterSuits, iterRanks));
+                }
             }
         }
 
+        m_rankRemaining.fill(static_cast<uint16_t>(m_numDecks * NUMSUITS));
+        m_rankDiscarded.fill(0);
+        setCountSystem(m_countSystem);
+    }
+    /*
+        switches the count system. the tags get re-summed from the rank tallies, so this is
+        fine to do at any point in the shoe.
+    */
+    void setCountSystem(const CountSystem& system){
+        m_countSystem = system;
+        m_remainingTags = 0;
+        m_discardedTags = 0;
+        for (int r = 0; r < NUMRANKS; r++){
+            m_rankTags[r] = system.tags[CARD_VALUES[r] - 2];
+            m_remainingTags += m_rankTags[r] * m_rankRemaining[r];
+            m_discardedTags += m_rankTags[r] * m_rankDiscarded[r];
+        }
     }
-    // Deck operations
     
     //One a one card per deal basis, to make things easier later.
     //Obviously, standard dealing will start with two cards, easy loops.
     void shuffleDeck() {
-        /*
-        a key issue that needs to be addressed is a lists inability to iterate randomly
-        hence, a custom shuffle algorithm needs to be used. 
-        */
-        random_device rd;
-        mt19937 gen(rd());
-        int n = distance(cards.begin(), cards.end());
-        auto it = cards.begin();
-        for (int i = n - 1; i > 0; --i) {
-            uniform_int_distribution<> distrib(0, i);
-            int j = distrib(gen);
-            auto it_j = cards.begin();
-            std::advance(it_j, j);
-            std::iter_swap(it, it_j);
-            std::advance(it, 1);
+        shuffleDeck(m_rng);
+    }
+    /*
+        plain Fisher-Yates over the cards that haven't been dealt yet, one swap per card.
+        any standard random engine can be passed in, the no argument version uses the deck's own.
+    */
+    template <class Engine>
+    void shuffleDeck(Engine& gen) {
+        uniform_int_distribution<size_t> distrib;
+        size_t n = cards.size() - m_next;
+        Card* undealt = cards.data() + m_next;
+        for (size_t i = n; i > 1; --i) {
+            size_t j = distrib(gen, uniform_int_distribution<size_t>::param_type(0, i - 1));
+            swap(undealt[i - 1], undealt[j]);
         }
     }
+    /*
+        reseeds the generator. stream lets several decks share one seed but still draw
+        independent sequences (one per simulation worker).
+    */
+    void seed(uint64_t seedValue, uint32_t stream = 0){
+        seed_seq seq{static_cast<uint32_t>(seedValue), static_cast<uint32_t>(seedValue >> 32), stream};
+        m_rng.seed(seq);
+    }
     Card deal(){
-        Card dealtCard = cards.front();
-        cards.pop_front();
-        return dealtCard;
+        //Ran dry mid-round, so put the discards back in and shuffle rather than reading past the end.
+        if (m_next == cards.size()){
+            retrieveCardsFromDiscardPile();
+            shuffleDeck();
+            //Nothing was on the discard pile either, every card is out on the table.
+            if (m_next == cards.size()){
+                throw ShoeExhausted();
+            }
+        }
+        Card card = cards[m_next++];
+        int rank = card.rankIndex();
+        m_rankRemaining[rank]--;
+        m_remainingTags -= m_rankTags[rank];
+        return card;
     }
-    //After rounds, add card or cards to discardPile stack.
+    //After rounds, add card or cards to discardPile.
     void addToDiscardPile(const Card& card){
-        discardPile.push(card);
+        discardPile.push_back(card);
+        int rank = card.rankIndex();
+        m_rankDiscarded[rank]++;
+        m_discardedTags += m_rankTags[rank];
     }
-    //Resets discardPile deck back into existing card deck.
+    /*
+        Resets discardPile back into existing card deck. the undealt cards slide down to the front
+        and the discards go in behind them, all inside the space the shoe already has.
+    */
     void retrieveCardsFromDiscardPile(){
-        while(!discardPile.empty()){
-            cards.push_back(discardPile.top());
-            discardPile.pop();
+        cards.erase(cards.begin(), cards.begin() + m_next);
+        m_next = 0;
+        cards.insert(cards.end(), discardPile.begin(), discardPile.end());
+        discardPile.clear();
+
+        for (int r = 0; r < NUMRANKS; r++){
+            m_rankRemaining[r] += m_rankDiscarded[r];
         }
+        m_rankDiscarded.fill(0);
+        m_remainingTags += m_discardedTags;
+        m_discardedTags = 0;
+    }
+    //Cut card has come out, time to reshuffle before the next round.
+    bool needsReshuffle() const{
+        return cardsRemaining() <= m_cutCardRemaining;
+    }
+    //Puts the whole discard pile back in and shuffles, meant for between rounds.
+    void reshuffle(){
+        retrieveCardsFromDiscardPile();
+        shuffleDeck();
+    }
+    int getNumDecks() const{
+        return m_numDecks;
+    }
+    double getPenetration() const{
+        return m_penetration;
     }
     //Simple getter to check if deck has been emptied.
     bool isEmpty() const{
-        if (cards.empty()){
-            return true;
-        }
-        return false;
+        return m_next == cards.size();
     }
     int cardsRemaining() const{
-        return static_cast<int>(cards.size());
+        return static_cast<int>(cards.size() - m_next);
+    }
+    //Counts of every undealt card by value, for the odds engine.
+    ShoeComposition getComposition() const{
+        ShoeComposition shoe{};
+        for (int r = 0; r < NUMRANKS; r++){
+            shoe[CARD_VALUES[r] - 2] += m_rankRemaining[r];
+        }
+        return shoe;
+    }
+    //Undealt cards of one rank (rank index, 0 for 2s up to ACE).
+    int rankRemaining(int rank) const{
+        return m_rankRemaining[rank];
+    }
+    const CountSystem& getCountSystem() const{
+        return m_countSystem;
+    }
+    /*
+        running count of every card dealt since the shoe was last shuffled. cards still out on the
+        table when the discards get shuffled back in stay counted, they haven't gone back in yet.
+        it starts at pivot minus the full shoe's tags and gains the tags of each card dealt, which
+        comes down to pivot minus the tags still in the shoe.
+    */
+    int runningCount() const{
+        return m_countSystem.pivot - m_remainingTags;
+    }
+    double decksRemaining() const{
+        return static_cast<double>(cardsRemaining()) / MAXCARDS;
+    }
+    //Running count per deck left to deal. with under half a deck left it's divided by a half, like counters do.
+    double trueCount() const{
+        return runningCount() / max(decksRemaining(), 0.5);
     }
 
     //For future bot logic, action logs, game flow, etc.
     void toString() const{
-        cout << "Deck size is: " << cards.size() << endl;
+        cout << "Deck size is: " << cardsRemaining() << endl;
         cout << "Discard Pile size is " << discardPile.size() << endl;
+        cout << "Running count (" << m_countSystem.name << ") is " << runningCount()
+             << ", true count " << fixed << setprecision(1) << trueCount() << endl;
     }
 };
 
 
+/*
+    the most cards one hand can ever hold: 21 cards worth a point each, then the one that busts it.
+    hands keep their cards inline, so dealing and splitting never touch the heap.
+*/
+const int MAXHANDCARDS = 22;
+
 class Hand {
 protected:
-    deque<Card> hand_cards;
+    array<Card, MAXHANDCARDS> hand_cards;
+    int m_size;
+
+    /*
+        running totals, kept up to date by add()/clear() so nothing has to walk the cards again.
+        m_hardTotal counts every ace as 1, m_aces is how many of them are in the hand.
+    */
+    int m_hardTotal;
+    int m_aces;
     
 public:
     // Constructor, but hands are dealt empty as per game logic.
-    Hand(){}
+    Hand() : m_size(0), m_hardTotal(0), m_aces(0){}
     // Hand operations
     void add(const Card& card){
-        hand_cards.push_back(card);
+        hand_cards[m_size++] = card;
+        if (card.isAce()){
+            m_hardTotal += 1;
+            m_aces++;
+        }
+        else{
+            m_hardTotal += card.getValue();
+        }
+    }
+    //Takes the last card back out, which is how a pair gets split into two hands.
+    Card removeLast(){
+        Card card = hand_cards[--m_size];
+        if (card.isAce()){
+            m_hardTotal -= 1;
+            m_aces--;
+        }
+        else{
+            m_hardTotal -= card.getValue();
+        }
+        return card;
     }
     void clear() {
-        hand_cards.clear();
+        m_size = 0;
+        m_hardTotal = 0;
+        m_aces = 0;
     }
 
     /*
-        getTotal() collects and returns the total value of the hand (obviously to use in the blackjack
+        getTotal() returns the total value of the hand (obviously to use in the blackjack
         determinant).
 
-        int aces keeps track of all aces to be processed differently as per game logic. 
-        cards are ranked by either ace, face card, or numerical card, and stored as such with a point value
-
-        for loop from lines 212 to 218 treat aces based on if they would cause the hand to be bust,
-        which the player obviously did not intend to do. so, if the total plus the ace is less than or equal
-        to 21, we just add it as 11. otherwise, it's just a one, yay!
+        aces all start out as 1 in the hard total. at most one of them can ever be worth 11
+        (two would already be 22), so if there is an ace and the extra 10 doesn't bust us, we take it.
+        no more loops, the answer is always ready.
     */
 
     int getTotal() const{
-
-        int total = 0;
-        int aces = 0;
-
-        for (const auto& card : hand_cards){
-
-            string rank = card.getRank();
-            if (rank == "Ace") {
-                aces++;
-            }
-            else if (rank == "King" || rank == "Queen" || rank == "Jack") {
-                total += 10;
-            }
-            else {
-                total += stoi(rank);
-            }
-        }
-
-        for (int i = 0 ; i < aces ; i++){
-                if (total + 11 <= 21) {
-                    total += 11;
-                }
-                else {
-                    total += 1;
-                }
-
-        }
-
-        return total;
+        return (isSoft() ? m_hardTotal + 10 : m_hardTotal);
+    }
+    int getHardTotal() const{
+        return m_hardTotal;
+    }
+    bool hasAce() const{
+        return m_aces > 0;
     }
     /*
         basic getter functions for game logic.
     */
     bool isBusted() const {
-        
-        if (getTotal() > 21) {
-            return true;
-        }
-
-        return false;
+        return m_hardTotal > 21;
     }
     bool isBlackjack() const {
-
-        if (hand_cards.size() == 2 && getTotal() == 21) {
-            return true;
-        }
-
-        return false;
+        return m_size == 2 && getTotal() == 21;
+    }
+    //Soft means an ace is still being counted as 11.
+    bool isSoft() const {
+        return m_aces > 0 && m_hardTotal + 10 <= 21;
+    }
+    //Two cards of the same value, the only hands that can be split.
+    bool isPair() const {
+        return m_size == 2 && hand_cards[0].getValue() == hand_cards[1].getValue();
+    }
+    int size() const {
+        return m_size;
     }
 
     /*
@@ -250,29 +577,29 @@ public:
         to be extended to all other classes utilizing card structure iteration
 
     */
-    deque<Card>::iterator begin() {
-        return hand_cards.begin();
+    Card* begin() {
+        return hand_cards.data();
     }
     
-    deque<Card>::iterator end() {
-        return hand_cards.end();
+    Card* end() {
+        return hand_cards.data() + m_size;
     }
-    deque<Card>::const_iterator begin() const {
-        return hand_cards.cbegin();
+    const Card* begin() const {
+        return hand_cards.data();
     }
     
-    deque<Card>::const_iterator end() const {
-        return hand_cards.cend();
+    const Card* end() const {
+        return hand_cards.data() + m_size;
     }
 
 
     void toString() const{
 
-        if (hand_cards.empty()){
+        if (m_size == 0){
             cout << "Hand's empty...";
         }
 
-        for (const auto& card : hand_cards){
+        for (const auto& card : *this){
             if (card.isFaceUp()) {
                 cout << card.getRank() << " of " << card.getSuit() << ", ";
             }
@@ -286,16 +613,301 @@ public:
 };
 
 
+/*
+    everything a seat can do on its turn. the strategy table only ever answers with these,
+    so bots and people at the terminal go through the same code in Game::playerTurns().
+*/
+enum class Action : uint8_t { HIT, STAND, DOUBLE, SPLIT, SURRENDER };
+
+/*
+    basic strategy chart, multi deck, dealer stands on soft 17, double after split allowed.
+    columns are the dealer's upcard, 2 through 10 and then the ace.
+
+    H = hit, S = stand, Dh = double (hit if doubling isn't allowed), Ds = double (otherwise stand),
+    P = split. pairs only list whether to split, a pair that isn't split is played off the hard or soft rows.
+    late surrender sits on top of the chart: hard 16 gives up against a 9, 10 or ace, hard 15 against a 10.
+*/
+enum class StrategyCell : uint8_t { H, S, Dh, Ds, P };
+
+const int NUMUPCARDS = 10;
+const int HARDMIN = 4;
+const int SOFTMIN = 12;
+
+namespace chart {
+constexpr StrategyCell H = StrategyCell::H;
+constexpr StrategyCell S = StrategyCell::S;
+constexpr StrategyCell Dh = StrategyCell::Dh;
+constexpr StrategyCell Ds = StrategyCell::Ds;
+constexpr StrategyCell P = StrategyCell::P;
+
+//Hard totals 4 through 21.
+constexpr StrategyCell HARD[21 - HARDMIN + 1][NUMUPCARDS] = {
+    //   2   3   4   5   6   7   8   9  10   A
+    {    H,  H,  H,  H,  H,  H,  H,  H,  H,  H }, // 4
+    {    H,  H,  H,  H,  H,  H,  H,  H,  H,  H }, // 5
+    {    H,  H,  H,  H,  H,  H,  H,  H,  H,  H }, // 6
+    {    H,  H,  H,  H,  H,  H,  H,  H,  H,  H }, // 7
+    {    H,  H,  H,  H,  H,  H,  H,  H,  H,  H }, // 8
+    {    H, Dh, Dh, Dh, Dh,  H,  H,  H,  H,  H }, // 9
+    {   Dh, Dh, Dh, Dh, Dh, Dh, Dh, Dh,  H,  H }, // 10
+    {   Dh, Dh, Dh, Dh, Dh, Dh, Dh, Dh, Dh,  H }, // 11
+    {    H,  H,  S,  S,  S,  H,  H,  H,  H,  H }, // 12
+    {    S,  S,  S,  S,  S,  H,  H,  H,  H,  H }, // 13
+    {    S,  S,  S,  S,  S,  H,  H,  H,  H,  H }, // 14
+    {    S,  S,  S,  S,  S,  H,  H,  H,  H,  H }, // 15
+    {    S,  S,  S,  S,  S,  H,  H,  H,  H,  H }, // 16
+    {    S,  S,  S,  S,  S,  S,  S,  S,  S,  S }, // 17
+    {    S,  S,  S,  S,  S,  S,  S,  S,  S,  S }, // 18
+    {    S,  S,  S,  S,  S,  S,  S,  S,  S,  S }, // 19
+    {    S,  S,  S,  S,  S,  S,  S,  S,  S,  S }, // 20
+    {    S,  S,  S,  S,  S,  S,  S,  S,  S,  S }, // 21
+};
+
+//Soft totals 12 (A,A when it isn't split, no card can bust it) through 21 (A,10).
+constexpr StrategyCell SOFT[21 - SOFTMIN + 1][NUMUPCARDS] = {
+    //   2   3   4   5   6   7   8   9  10   A
+    {    H,  H,  H,  H,  H,  H,  H,  H,  H,  H }, // 12
+    {    H,  H,  H, Dh, Dh,  H,  H,  H,  H,  H }, // 13
+    {    H,  H,  H, Dh, Dh,  H,  H,  H,  H,  H }, // 14
+    {    H,  H, Dh, Dh, Dh,  H,  H,  H,  H,  H }, // 15
+    {    H,  H, Dh, Dh, Dh,  H,  H,  H,  H,  H }, // 16
+    {    H, Dh, Dh, Dh, Dh,  H,  H,  H,  H,  H }, // 17
+    {    S, Ds, Ds, Ds, Ds,  S,  S,  H,  H,  H }, // 18
+    {    S,  S,  S,  S,  S,  S,  S,  S,  S,  S }, // 19
+    {    S,  S,  S,  S,  S,  S,  S,  S,  S,  S }, // 20
+    {    S,  S,  S,  S,  S,  S,  S,  S,  S,  S }, // 21
+};
+
+//Pairs by card value, 2,2 through A,A (value 11).
+constexpr StrategyCell PAIRS[NUMUPCARDS][NUMUPCARDS] = {
+    //   2   3   4   5   6   7   8   9  10   A
+    {    P,  P,  P,  P,  P,  P,  H,  H,  H,  H }, // 2,2
+    {    P,  P,  P,  P,  P,  P,  H,  H,  H,  H }, // 3,3
+    {    H,  H,  H,  P,  P,  H,  H,  H,  H,  H }, // 4,4
+    {    H,  H,  H,  H,  H,  H,  H,  H,  H,  H }, // 5,5
+    {    P,  P,  P,  P,  P,  H,  H,  H,  H,  H }, // 6,6
+    {    P,  P,  P,  P,  P,  P,  H,  H,  H,  H }, // 7,7
+    {    P,  P,  P,  P,  P,  P,  P,  P,  P,  P }, // 8,8
+    {    P,  P,  P,  P,  P,  S,  P,  P,  S,  S }, // 9,9
+    {    S,  S,  S,  S,  S,  S,  S,  S,  S,  S }, // 10,10
+    {    P,  P,  P,  P,  P,  P,  P,  P,  P,  P }, // A,A
+};
+}
+
+/*
+    looks up the chart. total/soft describe the hand, pairValue is the card value when the hand is
+    a pair (0 otherwise), upValue is the dealer's upcard value (ace = 11). canDouble/canSplit/canSurrender
+    let the table say no, in which case the cell falls back to what the chart would do without that option.
+*/
+constexpr Action basicStrategy(int total, bool soft, int pairValue, int upValue, bool canDouble = true, bool canSplit = true,
+                               bool canSurrender = false){
+    int col = upValue - 2;
+
+    if (pairValue != 0 && canSplit && chart::PAIRS[pairValue - 2][col] == StrategyCell::P){
+        return Action::SPLIT;
+    }
+    if (canSurrender && !soft && ((total == 16 && upValue >= 9) || (total == 15 && upValue == 10))){
+        return Action::SURRENDER;
+    }
+
+    StrategyCell cell = StrategyCell::S;
+    if (soft && total >= SOFTMIN){
+        cell = chart::SOFT[total - SOFTMIN][col];
+    }
+    else if (total >= HARDMIN){
+        cell = chart::HARD[min(total, 21) - HARDMIN][col];
+    }
+    else{
+        cell = StrategyCell::H;
+    }
+
+    switch (cell){
+        case StrategyCell::Dh:
+            return canDouble ? Action::DOUBLE : Action::HIT;
+        case StrategyCell::Ds:
+            return canDouble ? Action::DOUBLE : Action::STAND;
+        case StrategyCell::S:
+            return Action::STAND;
+        default:
+            return Action::HIT;
+    }
+}
+
+//Spot checks, so a typo in the chart won't compile.
+static_assert(basicStrategy(16, false, 0, 10) == Action::HIT, "hard 16 hits a 10");
+static_assert(basicStrategy(11, false, 0, 6) == Action::DOUBLE, "11 doubles a 6");
+static_assert(basicStrategy(18, true, 0, 6, false) == Action::STAND, "soft 18 stands when it can't double");
+static_assert(basicStrategy(16, false, 8, 11) == Action::SPLIT, "always split 8s");
+static_assert(basicStrategy(20, false, 10, 6) == Action::STAND, "never split 10s");
+static_assert(basicStrategy(16, false, 0, 10, true, true, true) == Action::SURRENDER, "16 gives up to a 10");
+static_assert(basicStrategy(16, false, 8, 10, true, true, true) == Action::SPLIT, "8s split rather than surrender");
+static_assert(basicStrategy(12, true, 11, 5, true, false) == Action::HIT, "aces that can't split always hit");
+
+
+/*
+    what a seat gets to go on when it sizes its bet: the shoe's true count from the table, and its own
+    bankroll and how its last round went. the table fills in the count, the seat the rest.
+*/
+struct BetContext {
+    double trueCount = 0.0;
+    int money = 0;
+    int lastBet = 0; // 0 before the seat's first round
+    int lastNet = 0;
+};
+
+/*
+    bet sizing for seats that bet on their own. a policy is asked once a round before the deal and
+    answers in dollars, the seat then holds that to between $1 and whatever it has left, so a policy
+    can't bet money that isn't there. made by makeBetPolicy() from a short spec like "kelly:0.5",
+    which is also how replays write them down.
+*/
+class BetPolicy {
+protected:
+    string m_spec;
+    int m_unit; // the table minimum as far as the policy is concerned, and what ramps are counted in
+
+public:
+    BetPolicy(const string& spec, int unit) : m_spec(spec), m_unit(max(unit, 1)){}
+    virtual ~BetPolicy(){}
+
+    virtual int bet(const BetContext& table) = 0;
+    const string& spec() const{
+        return m_spec;
+    }
+    int unit() const{
+        return m_unit;
+    }
+};
+
+//The same bet every round, what every bot did before there were policies.
+class FlatBetPolicy : public BetPolicy {
+public:
+    FlatBetPolicy(const string& spec, int unit) : BetPolicy(spec, unit){}
+
+    int bet(const BetContext&) override{
+        return m_unit;
+    }
+};
+
+/*
+    bets fraction of what the Kelly criterion says for the edge the true count gives: about -0.5% off
+    the top plus 0.5% a count, over blackjack's variance of about 1.3 a hand. those are the usual hi-lo
+    rules of thumb, so other count systems are only roughly right. no edge, minimum bet.
+*/
+class KellyBetPolicy : public BetPolicy {
+private:
+    static constexpr double BASEEDGE = -0.005;
+    static constexpr double EDGEPERCOUNT = 0.005;
+    static constexpr double VARIANCE = 1.3;
+
+    double m_fraction;
+
+public:
+    KellyBetPolicy(const string& spec, int unit, double fraction) : BetPolicy(spec, unit), m_fraction(fraction){}
+
+    int bet(const BetContext& table) override{
+        double edge = BASEEDGE + EDGEPERCOUNT * table.trueCount;
+        if (edge <= 0.0){
+            return m_unit;
+        }
+        double stake = m_fraction * table.money * edge / VARIANCE;
+        return max(m_unit, static_cast<int>(min(stake, static_cast<double>(table.money))));
+    }
+};
+
+//One unit per true count above 1, between 1 and spread units. the classic counter's ramp.
+class CountRampPolicy : public BetPolicy {
+private:
+    int m_spread;
+
+public:
+    CountRampPolicy(const string& spec, int unit, int spread) : BetPolicy(spec, unit), m_spread(max(spread, 1)){}
+
+    int bet(const BetContext& table) override{
+        int units = static_cast<int>(floor(table.trueCount)) - 1;
+        return m_unit * min(max(units, 1), m_spread);
+    }
+};
+
+/*
+    doubles up after every loss and goes back to one unit after anything else, for comparison, since
+    it's the system everyone thinks can't lose. maxDoublings stands in for the table maximum.
+*/
+class MartingalePolicy : public BetPolicy {
+private:
+    int m_maxDoublings;
+
+public:
+    MartingalePolicy(const string& spec, int unit, int maxDoublings) : BetPolicy(spec, unit), m_maxDoublings(min(max(maxDoublings, 0), 20)){}
+
+    int bet(const BetContext& table) override{
+        if (table.lastNet >= 0 || table.lastBet == 0){
+            return m_unit;
+        }
+        long long doubled = 2LL * table.lastBet;
+        return static_cast<int>(min(doubled, static_cast<long long>(m_unit) << m_maxDoublings));
+    }
+};
+
+/*
+    builds a policy from its spec, with unit as the base bet:
+        flat, kelly[:FRACTION] (default 0.5), ramp[:SPREAD] (default 8), martingale[:DOUBLINGS] (default 10)
+    nullptr if the spec doesn't make sense.
+*/
+inline unique_ptr<BetPolicy> makeBetPolicy(const string& spec, int unit){
+    size_t colon = spec.find(':');
+    string name = spec.substr(0, colon);
+    string arg = colon == string::npos ? string() : spec.substr(colon + 1);
+    char* end = nullptr;
+    double value = arg.empty() ? 0.0 : strtod(arg.c_str(), &end);
+    if (!arg.empty() && (*end != '\0' || value <= 0.0)){
+        return nullptr;
+    }
+
+    if (name == "flat" && arg.empty()){
+        return make_unique<FlatBetPolicy>(spec, unit);
+    }
+    if (name == "kelly"){
+        return make_unique<KellyBetPolicy>(spec, unit, arg.empty() ? 0.5 : value);
+    }
+    if (name == "ramp"){
+        return make_unique<CountRampPolicy>(spec, unit, arg.empty() ? 8 : static_cast<int>(value));
+    }
+    if (name == "martingale"){
+        return make_unique<MartingalePolicy>(spec, unit, arg.empty() ? 10 : static_cast<int>(value));
+    }
+    return nullptr;
+}
+
+
+//Most hands one seat can end up playing after splitting and resplitting.
+const int MAXHANDS = 4;
+
 class Player {
 protected:
     string m_name;
-    Hand m_hand;
+    /*
+        a seat plays one hand until it splits, then up to MAXHANDS of them, each with its own bet.
+        m_activeHand is the one being played right now. the hands sit inline, a split just moves
+        a card from one to the next.
+    */
+    array<Hand, MAXHANDS> m_hands;
+    array<int, MAXHANDS> m_bets;
+    int m_numHands;
+    int m_activeHand;
     int m_money;
-    int m_bet;
+    int m_insurance; // side bet on the dealer having blackjack, 0 if it wasn't taken
+    bool m_surrendered;
+    bool m_splitAces; // split aces get one card each and that's it
+    uint8_t m_doubled; // bit i set once hand i has been doubled
+    int m_seat; // order the player joined the table in, stays put when others leave
+    long long m_profileSlot; // where this player's saved profile lives, -1 for bots and guests
     
 public:
     // Constructor/Destructor
-    Player(const string& name = "Player", int money = 1000): m_name(name), m_money(money), m_bet(0){}
+    Player(const string& name = "Player", int money = 1000): m_name(name), m_bets{}, m_numHands(1), m_activeHand(0), m_money(money),
+        m_insurance(0), m_surrendered(false), m_splitAces(false), m_doubled(0), m_seat(0), m_profileSlot(-1){}
+    virtual ~Player(){}
     
     // Getters
     string getName() const{
@@ -304,16 +916,77 @@ public:
     int getMoney() const {
         return m_money;
     }
+    //Bet on the hand being played, or on hand i.
     int getBet() const{
-        return m_bet;
+        return m_bets[m_activeHand];
+    }
+    int getBet(int i) const{
+        return m_bets[i];
+    }
+    int getNumHands() const{
+        return m_numHands;
+    }
+    int getActiveHand() const{
+        return m_activeHand;
+    }
+    int getInsurance() const{
+        return m_insurance;
+    }
+    bool hasSurrendered() const{
+        return m_surrendered;
+    }
+    bool hasDoubled(int i) const{
+        return (m_doubled >> i) & 1;
+    }
+    bool hasSplitAces() const{
+        return m_splitAces;
+    }
+    int getSeat() const{
+        return m_seat;
+    }
+    void setSeat(int seat){
+        m_seat = seat;
+    }
+    long long getProfileSlot() const{
+        return m_profileSlot;
+    }
+    void setProfileSlot(long long slot){
+        m_profileSlot = slot;
     }
     const Hand& getHand() const{
-        return m_hand;
+        return m_hands[m_activeHand];
+    }
+    const Hand& getHand(int i) const{
+        return m_hands[i];
     }
     Hand& getHandRef(){
-        return m_hand;
+        return m_hands[m_activeHand];
+    }
+    //Back to a single empty hand, ready for the next deal.
+    void clearHands(){
+        for (int i = 0; i < m_numHands; i++){
+            m_hands[i].clear();
+        }
+        m_numHands = 1;
+        m_activeHand = 0;
+    }
+    //Moves on to the next split hand, false once every hand has been played.
+    bool nextHand(){
+        if (m_activeHand + 1 >= m_numHands){
+            return false;
+        }
+        m_activeHand++;
+        return true;
     }
     
+    /*
+        the most this player can put down: their money, but never so much that splitting all the way,
+        doubling every hand and winning the lot would take them past what an int holds.
+    */
+    int maxBet() const{
+        int headroom = (numeric_limits<int>::max() - m_money) / (2 * MAXHANDS);
+        return min(m_money, max(headroom, 1));
+    }
     /*
         placeBet() verifies that the bet places is a legitmate amount, while also making sure the player
         isn't spending more money than they currently have.
@@ -324,25 +997,115 @@ public:
         good for game logic verification in gameloop()
     
     */
+    /*
+        pays money back to the player. maxBet() keeps anyone from betting enough to pass what an int holds,
+        but a seat sitting within a few dollars of it still bets $1, so the very top is where the house stops paying.
+    */
+    void credit(long long amount){
+        m_money = static_cast<int>(min(m_money + amount, static_cast<long long>(numeric_limits<int>::max())));
+    }
     bool placeBet(int amount){
-        if (amount <= 0 || amount > m_money){
+        if (amount <= 0 || amount > maxBet()){
             return false;
         }
 
-        m_bet = amount;
+        m_bets[0] = amount;
+        m_numHands = 1;
+        m_activeHand = 0;
+        m_insurance = 0;
+        m_surrendered = false;
+        m_splitAces = false;
+        m_doubled = 0;
         m_money -= amount;
         return true;
     }
     void win(){
-        m_money += (m_bet * 2);
-        m_bet = 0;
+        settle(m_activeHand, m_bets[m_activeHand]);
     }
     void lose(){
-        m_bet = 0;
+        settle(m_activeHand, -m_bets[m_activeHand]);
     }
     void push(){
-        m_money += m_bet;
-        m_bet = 0;
+        settle(m_activeHand, 0);
+    }
+    //Settles hand i for net on top of its bet coming back, negative net takes from the bet.
+    void settle(int i, int net){
+        credit(static_cast<long long>(m_bets[i]) + net);
+        m_bets[i] = 0;
+    }
+    //Gives back everything staked this round, bets on every hand and the insurance, for a round that got called off.
+    void returnBets(){
+        for (int i = 0; i < m_numHands; i++){
+            settle(i, 0);
+        }
+        credit(m_insurance);
+        m_insurance = 0;
+    }
+    //Doubling puts the same bet down again, the hand then gets exactly one more card.
+    bool doubleDown(){
+        int& bet = m_bets[m_activeHand];
+        if (bet > m_money){
+            return false;
+        }
+        m_money -= bet;
+        bet *= 2;
+        m_doubled |= 1 << m_activeHand;
+        return true;
+    }
+    bool canSplit() const{
+        return getHand().isPair() && m_numHands < MAXHANDS && getBet() <= m_money;
+    }
+    /*
+        split() moves the second card of the pair onto a new hand with the same bet again. each hand is
+        one card short afterwards, the table deals them their second card as it gets to them.
+    */
+    bool split(){
+        if (!canSplit()){
+            return false;
+        }
+        Hand& hand = m_hands[m_numHands];
+        hand.clear();
+        hand.add(getHandRef().removeLast());
+        m_splitAces = hand.hasAce();
+        m_bets[m_numHands] = getBet();
+        m_money -= getBet();
+        m_numHands++;
+        return true;
+    }
+    //Late surrender: the hand is given up before it's played and half the bet comes back at payout.
+    void surrender(){
+        m_surrendered = true;
+    }
+    //Insurance costs half the original bet and pays 2:1 if the dealer turns out to have blackjack.
+    bool insure(){
+        int cost = m_bets[0] / 2;
+        if (cost <= 0 || cost > m_money){
+            return false;
+        }
+        m_money -= cost;
+        m_insurance = cost;
+        return true;
+    }
+    //Pays or takes the insurance bet, returns what it made from the player's side.
+    int settleInsurance(bool dealerBlackjack){
+        int net = dealerBlackjack ? m_insurance * 2 : -m_insurance;
+        credit(static_cast<long long>(m_insurance) + net);
+        m_insurance = 0;
+        return net;
+    }
+
+    /*
+        chooseBet() asks the player at the terminal how much they want to put down. people can read
+        the table for themselves, so they don't need anything out of it. validation stays with
+        placeBet(), this just collects the number.
+    */
+    virtual int chooseBet(const BetContext&){
+        cout << m_name << " , you've got $" << m_money << ". Place your bet: $";
+
+        int bet;
+        cin >> bet;
+        cin.ignore(numeric_limits<streamsize>::max(), '\n');
+        return bet;
     }
     
     /*
@@ -354,7 +1117,7 @@ public:
         or not, returning a boolean value.  
     
     */
-     bool isHitting(){
+     virtual bool isHitting(){
 
         char pChoice;
         cout << m_name << ", " << "do you want to hit? (y/n)";
@@ -367,10 +1130,83 @@ public:
         return (pChoice == 'y' || pChoice == 'Y');
 
      }
+     /*
+        chooseAction() is what Game::playerTurns() actually asks, about the hand being played.
+        canDouble/canSplit/canSurrender say what the table allows right now. with nothing past hit or stand
+        on offer it's the old y/n question, bots override this with the chart.
+     */
+     virtual Action chooseAction(const Hand&, const Card&, bool canDouble, bool canSplit, bool canSurrender){
+        if (!canDouble && !canSplit && !canSurrender){
+            return isHitting() ? Action::HIT : Action::STAND;
+        }
+
+        //Anything the table doesn't offer gets asked again, rather than quietly standing the hand.
+        while (true){
+            cout << m_name << ", (h)it, (s)tand" << (canDouble ? ", (d)ouble" : "") << (canSplit ? ", s(p)lit" : "")
+                 << (canSurrender ? ", su(r)render" : "") << "? ";
+            char pChoice;
+            if (!(cin >> pChoice)){
+                return Action::STAND;
+            }
+            cin.ignore(numeric_limits<streamsize>::max(), '\n');
+
+            switch (tolower(pChoice)){
+                case 'h':
+                case 'y':
+                    return Action::HIT;
+                case 's':
+                case 'n':
+                    return Action::STAND;
+                case 'd':
+                    if (canDouble){
+                        return Action::DOUBLE;
+                    }
+                    break;
+                case 'p':
+                    if (canSplit){
+                        return Action::SPLIT;
+                    }
+                    break;
+                case 'r':
+                    if (canSurrender){
+                        return Action::SURRENDER;
+                    }
+                    break;
+            }
+            cout << "That isn't an option on this hand.\n";
+        }
+     }
+     //Asked when the dealer shows an ace, cost is what the insurance bet would be.
+     virtual bool takesInsurance(int cost){
+        char pChoice;
+        cout << m_name << ", the dealer shows an ace. Insurance for $" << cost << "? (y/n)";
+        cin >> pChoice;
+        cin.ignore(numeric_limits<streamsize>::max(), '\n');
+        return (pChoice == 'y' || pChoice == 'Y');
+     }
+     /*
+        true for people, whose bets and decisions arrive from outside the table (the terminal or a
+        network connection). the table never blocks asking them, it stops and waits for
+        Game::submitBet()/submitAction() instead. bots answer on the spot.
+     */
+     virtual bool awaitsInput() const{
+        return true;
+     }
+     //Nullptr for anyone who decides their own bets.
+     virtual const BetPolicy* getBetPolicy() const{
+        return nullptr;
+     }
+     virtual int getFlatBet() const{
+        return 0;
+     }
      void showHand(bool showFirstCard = true) const{
 
-        cout << m_name << "s hand: ";
-        m_hand.toString();
+        cout << m_name << "s hand";
+        if (m_numHands > 1){
+            cout << " " << m_activeHand + 1 << " of " << m_numHands;
+        }
+        cout << ": ";
+        getHand().toString();
         cout << endl;
         
      }
@@ -381,10 +1217,175 @@ public:
      deck/hand class functions, so accessors are needed.
     */
     bool isBusted() const{
-        return m_hand.isBusted();
+        return getHand().isBusted();
     }
+    //A natural only counts on the two cards dealt, 21 on a split hand is just 21.
     bool isBlackjack() const{
-        return m_hand.isBlackjack();
+        return m_numHands == 1 && m_hands[0].isBlackjack();
+    }
+    //Whether any hand is still around for the dealer to play against.
+    bool hasLiveHand() const{
+        if (m_surrendered){
+            return false;
+        }
+        for (int i = 0; i < m_numHands; i++){
+            if (!m_hands[i].isBusted()){
+                return true;
+            }
+        }
+        return false;
+    }
+};
+
+
+/*
+    BotPlayer never touches cin, so a table full of them can run unattended, and it can just as well
+    sit next to people at the terminal. it flat bets and plays every hand off the basic strategy chart.
+*/
+class BotPlayer : public Player {
+private:
+    int m_flatBet;
+    //Nullptr bets m_flatBet every round.
+    unique_ptr<BetPolicy> m_policy;
+    int m_lastBet;
+    int m_moneyBeforeBet;
+
+public:
+    BotPlayer(const string& name = "Bot", int money = 1000, int flatBet = 10, unique_ptr<BetPolicy> policy = nullptr)
+        : Player(name, money), m_flatBet(flatBet), m_policy(move(policy)), m_lastBet(0), m_moneyBeforeBet(money){}
+
+    int chooseBet(const BetContext& table) override{
+        int bet = m_flatBet;
+        if (m_policy){
+            BetContext seat = lastRound();
+            seat.trueCount = table.trueCount;
+            bet = max(m_policy->bet(seat), 1);
+        }
+        bet = min(bet, maxBet());
+        m_lastBet = bet;
+        m_moneyBeforeBet = m_money;
+        return bet;
+    }
+    const BetPolicy* getBetPolicy() const override{
+        return m_policy.get();
+    }
+    void setBetPolicy(unique_ptr<BetPolicy> policy){
+        m_policy = move(policy);
+    }
+    //The seat's side of its next BetContext: its money and how its last round went, which progressions bet off.
+    BetContext lastRound() const{
+        BetContext seat;
+        seat.money = m_money;
+        seat.lastBet = m_lastBet;
+        seat.lastNet = m_lastBet ? m_money - m_moneyBeforeBet : 0;
+        return seat;
+    }
+    //Picks up betting as if the last round had gone like that, for a replay that starts partway through a session.
+    void resumeBetting(int lastBet, int lastNet){
+        m_lastBet = lastBet;
+        m_moneyBeforeBet = m_money - lastNet;
+    }
+    bool awaitsInput() const override{
+        return false;
+    }
+    int getFlatBet() const override{
+        return m_flatBet;
+    }
+    //Without an upcard to look at, the best a bot can do is play like the dealer.
+    bool isHitting() override{
+        return getHand().getTotal() < 17;
+    }
+    Action chooseAction(const Hand& hand, const Card& dealerUpcard, bool canDouble, bool canSplit, bool canSurrender) override{
+        int pairValue = hand.isPair() ? hand.begin()->getValue() : 0;
+        return basicStrategy(hand.getTotal(), hand.isSoft(), pairValue, dealerUpcard.getValue(), canDouble, canSplit, canSurrender);
+    }
+    //Basic strategy never takes insurance.
+    bool takesInsurance(int) override{
+        return false;
+    }
+};
+
+
+/*
+    the house rules a table deals by. the defaults are the table as it's always been (one deck, dealer
+    stands on soft 17, double on any two cards and after splits, split to 4 hands, late surrender),
+    apart from blackjack paying 3:2 like it's supposed to.
+
+    the round never branches on them per card or per hand: the soft 17 rule and the payout pick template
+    specializations once per round (Game::dealerDraws(), NaturalPayout), and what can be doubled is a
+    bitmask of totals worked out when the rules are set.
+*/
+enum class BlackjackPayout : uint8_t { THREE_TO_TWO, SIX_TO_FIVE, EVEN_MONEY };
+enum class DoubleRule : uint8_t { ANY_TWO, NINE_TO_ELEVEN, TEN_OR_ELEVEN };
+
+struct TableRules {
+    int numDecks = 1;
+    bool hitSoft17 = false;
+    BlackjackPayout blackjackPays = BlackjackPayout::THREE_TO_TWO;
+    DoubleRule doubleOn = DoubleRule::ANY_TWO;
+    bool doubleAfterSplit = true;
+    int maxHands = MAXHANDS; // 1 turns splitting off
+    bool lateSurrender = true;
+
+    //Two card totals a player may double on, bit t set for a total of t.
+    uint32_t doubleTotals() const{
+        switch (doubleOn){
+            case DoubleRule::NINE_TO_ELEVEN:
+                return (1u << 9) | (1u << 10) | (1u << 11);
+            case DoubleRule::TEN_OR_ELEVEN:
+                return (1u << 10) | (1u << 11);
+            default:
+                return ~0u;
+        }
+    }
+    bool canDoubleOn(int total, bool afterSplit) const{
+        return ((doubleTotals() >> total) & 1) && (!afterSplit || doubleAfterSplit);
+    }
+
+    string describe() const{
+        const char* PAYOUTS[] = {"3:2", "6:5", "1:1"};
+        const char* DOUBLES[] = {"any two cards", "9-11", "10-11"};
+        ostringstream out;
+        out << numDecks << (numDecks == 1 ? " deck" : " decks")
+            << ", dealer " << (hitSoft17 ? "hits" : "stands on") << " soft 17"
+            << ", blackjack pays " << PAYOUTS[static_cast<int>(blackjackPays)]
+            << ", double on " << DOUBLES[static_cast<int>(doubleOn)] << (doubleAfterSplit ? " and after splits" : " but not after splits")
+            << ", " << (maxHands > 1 ? "split to " + to_string(maxHands) + " hands" : string("no splitting"))
+            << (lateSurrender ? ", late surrender" : ", no surrender");
+        return out.str();
+    }
+
+    //The payout the way it's printed on the felt: 3:2, 6:5 or 1:1.
+    static bool parsePayout(const string& text, BlackjackPayout& pays){
+        if (text == "3:2"){
+            pays = BlackjackPayout::THREE_TO_TWO;
+        }
+        else if (text == "6:5"){
+            pays = BlackjackPayout::SIX_TO_FIVE;
+        }
+        else if (text == "1:1"){
+            pays = BlackjackPayout::EVEN_MONEY;
+        }
+        else{
+            return false;
+        }
+        return true;
+    }
+    //any, 9-11 or 10-11.
+    static bool parseDoubleRule(const string& text, DoubleRule& rule){
+        if (text == "any"){
+            rule = DoubleRule::ANY_TWO;
+        }
+        else if (text == "9-11"){
+            rule = DoubleRule::NINE_TO_ELEVEN;
+        }
+        else if (text == "10-11"){
+            rule = DoubleRule::TEN_OR_ELEVEN;
+        }
+        else{
+            return false;
+        }
+        return true;
     }
 };
 
@@ -392,23 +1393,32 @@ public:
 class Dealer : public Player {
 private:
     Deck m_deck;
+    bool m_hitSoft17;
     
 public:
     // Constructor
-    Dealer(const string& name = "The Dealer"){};
+    Dealer(const string& name = "The Dealer") : m_hitSoft17(false){};
     /*
     unlike the player function couterpart, we need to apply some sort of basic logic to
     the dealer. based on casino rules, the dealer MUST hit on a total sum of 16 or less,
-    and stand on a hand of total 17 or more. 
+    and stand on a hand of total 17 or more. soft 17 is up to the table (TableRules::hitSoft17).
     
     this saves us a lot of unneccessary bot logic as now all we need is to determine the card
     total.
     */
     bool isHitting() const{
-        if (m_hand.getTotal() < 17){
-            return true;
-        }
-        return false;
+        return hitsOn(getHand().getTotal(), getHand().isSoft(), m_hitSoft17);
+    }
+    void setHitsSoft17(bool hitSoft17){
+        m_hitSoft17 = hitSoft17;
+    }
+    //The rule itself, pulled out so the odds engine plays the dealer exactly the same way.
+    template <bool HitSoft17>
+    static bool hitsOn(int total, bool soft){
+        return total < 17 || (HitSoft17 && soft && total == 17);
+    }
+    static bool hitsOn(int total, bool soft, bool hitSoft17){
+        return hitSoft17 ? hitsOn<true>(total, soft) : hitsOn<false>(total, soft);
     }
     /*
     
@@ -419,7 +1429,7 @@ public:
     void showHand(bool showFirstCard = true) const{
         if (showFirstCard){
             cout << m_name << "'s hand: ";
-            m_hand.toString();
+            getHand().toString();
             cout << endl;
         }else{
             cout << m_name << "'s hand: [FACED DOWN], ";
@@ -428,9 +1438,9 @@ public:
             Set an auto variable to the beginning of the hand, and fetch the rank and respective
             suit of the card while it iterates until it does not equal the end value of the hand.
         */
-       auto it = m_hand.begin();
+       auto it = getHand().begin();
        it++;
-        for (; it != m_hand.end() ; it++) {
+        for (; it != getHand().end() ; it++) {
             const Card& card = *it;
             cout << card.getRank() << " of " << card.getSuit() << ", ";
         }
@@ -443,592 +1453,5789 @@ public:
     void shuffleDeck(){
         m_deck.shuffleDeck();
     }
+    void seedDeck(uint64_t seedValue, uint32_t stream = 0){
+        m_deck.seed(seedValue, stream);
+    }
+    void configureShoe(int numDecks, double penetration = DEFAULTPENETRATION){
+        m_deck.configure(numDecks, penetration);
+    }
+    void setCountSystem(const CountSystem& system){
+        m_deck.setCountSystem(system);
+    }
+    bool shoeNeedsReshuffle() const{
+        return m_deck.needsReshuffle();
+    }
+    void reshuffle(){
+        m_deck.reshuffle();
+    }
+    const Deck& getDeck() const{
+        return m_deck;
+    }
     Card deal(){
         return m_deck.deal();
     }
+    //The card everyone gets to see, the first one dealt stays face down.
+    const Card& getUpcard() const{
+        return *(getHand().begin() + 1);
+    }
+    void discard(const Card& card){
+        m_deck.addToDiscardPile(card);
+    }
     bool deckIsEmpty() const{
         return m_deck.isEmpty();
     }
 };
 
 
-class GameStats {
-private:
-    unordered_map<string, pair<int, int>> m_playerStats; // <name, <wins, losses>>
-    set<pair<int, string>> m_highScores; // <money, name>
-    
-public:
+/*
+    final results the dealer can end up with. DEALER_LOW only happens when the shoe runs out of cards
+    mid-draw in the math below, a real table would have reshuffled by then.
+*/
+enum DealerResult { DEALER_LOW, DEALER_17, DEALER_18, DEALER_19, DEALER_20, DEALER_21, DEALER_BUST, DEALER_BLACKJACK, NUMDEALERRESULTS };
 
-    GameStats(){};
-    
-    void recordWin(const string& playerName){
-        m_playerStats[playerName].first++;
-    }
-    void recordLoss(const string& playerName){
-        m_playerStats[playerName].second++;
-    }
+struct DealerDistribution {
+    array<double, NUMDEALERRESULTS> p{};
+};
 
-    /*
+/*
+    DealerOddsEngine works out exact probabilities off the cards left in the shoe, instead of dealing
+    millions of hands to estimate them. every way the dealer can finish from an upcard under
+    Dealer::hitsOn() is listed once, as the cards drawn, and any shoe is priced as a sum over that list.
 
-        Updates high score by iterating through the set of highscores, and if a players score is found
-        erase it for updating with a new entry with the new money and new name.
-    
+    the same shoe shows up over and over, both inside one query and between queries during a shoe, so
+    results are memoized on the exact composition. the cache only grows, call clear() after a reshuffle
+    if memory matters.
+
+    on top of the dealer's odds it prices every decision a player can make (stand, hit, double, split,
+    surrender) for the exact cards left, so a whole strategy chart falls out of a few hundred queries
+    that mostly land on states an earlier query already worked out.
+*/
+class DealerOddsEngine {
+private:
+    /*
+        whatever hand state the recursion is in, plus the shoe it's drawing from. context is the dealer's
+        upcard, the dealer memo leaves the hand at 0.
     */
-    void updateHighScore(const string& playerName, int money){
-        for (auto x = m_highScores.begin() ; x != m_highScores.end();){
-            if (x->second == playerName){
-                x = m_highScores.erase(x);
-            }
-            else{
-                x++;
+    struct StateKey {
+        ShoeComposition shoe;
+        uint8_t hardTotal;
+        uint8_t hasAce;
+        uint8_t context;
+
+        bool operator==(const StateKey& other) const{
+            return shoe == other.shoe && hardTotal == other.hardTotal && hasAce == other.hasAce && context == other.context;
+        }
+    };
+    struct StateKeyHash {
+        size_t operator()(const StateKey& key) const{
+            //FNV-1a over the counts and the hand.
+            uint64_t h = 1469598103934665603ULL;
+            for (uint16_t count : key.shoe){
+                h = (h ^ count) * 1099511628211ULL;
             }
+            h = (h ^ key.hardTotal) * 1099511628211ULL;
+            h = (h ^ key.hasAce) * 1099511628211ULL;
+            h = (h ^ key.context) * 1099511628211ULL;
+            return static_cast<size_t>(h);
         }
+    };
 
-        m_highScores.insert(make_pair(money, playerName));
+    /*
+        one way for the dealer to finish: the cards drawn after the upcard, how many different orders of
+        them the dealer would actually play out, and what it ends on. any order of the same cards is
+        exactly as likely as any other out of any shoe, which is what lets a shoe be priced as a sum.
+    */
+    struct DealerFinish {
+        double orders;
+        uint8_t result; // a DealerResult
+        uint8_t cards;
+        uint8_t parts;  // distinct values drawn, the first parts entries of value/count
+        array<uint8_t, NUMVALUES> value;
+        array<uint8_t, NUMVALUES> count;
+    };
+
+    //By upcard index, each built the first time it's asked for since it only depends on the dealer's rules.
+    array<vector<DealerFinish>, NUMVALUES> m_finishes;
+    unordered_map<StateKey, DealerDistribution, StateKeyHash> m_dealerMemo;
+    unordered_map<StateKey, double, StateKeyHash> m_hitMemo;
+    //Whether the player is deciding after a peek, i.e. already knows a 10 or ace up isn't a blackjack.
+    bool m_peeked;
+    TableRules m_rules;
+
+    static int softTotal(int hardTotal, bool hasAce){
+        return (hasAce && hardTotal + 10 <= 21) ? hardTotal + 10 : hardTotal;
     }
-    
-    // Getters
-    int getWins(const string& playerName) const{
-        auto gW = m_playerStats.find(playerName);
-        if (gW != m_playerStats.end()){
-            return gW->second.first;
+
+    //Plays every sequence of draws out from the upcard, counting how many orders reach each finish.
+    void listFinishes(map<pair<array<uint8_t, NUMVALUES>, uint8_t>, double>& found, array<uint8_t, NUMVALUES>& drawn,
+                      int hardTotal, bool hasAce, int numCards){
+        int total = softTotal(hardTotal, hasAce);
+        int result = -1;
+        if (hardTotal > 21){
+            result = DEALER_BUST;
         }
-        return 0;
-    }
-    int getLosses(const string& playerName) const{
-        auto gL = m_playerStats.find(playerName);
-        if (gL != m_playerStats.end()){
-            return gL->second.second;
+        else if (numCards == 2 && total == 21){
+            result = DEALER_BLACKJACK;
         }
-        return 0;
-    }
-    double getWinRate(const string& playerName) const{
-        auto gWR = m_playerStats.find(playerName);
-        if (gWR != m_playerStats.end()){
-            int wins = gWR->second.first;
-            int losses = gWR->second.second;
-            int total = wins + losses;
-            if (total > 0){
-            return static_cast<double>(wins) / total;
-            }
+        //Stands the same way the dealer at the table does.
+        else if (numCards >= 2 && !Dealer::hitsOn(total, total != hardTotal, m_rules.hitSoft17)){
+            result = DEALER_17 + (total - 17);
+        }
+        if (result >= 0){
+            found[make_pair(drawn, static_cast<uint8_t>(result))] += 1.0;
+            return;
+        }
+
+        for (int v = 0; v < NUMVALUES; v++){
+            bool ace = (v == NUMVALUES - 1);
+            drawn[v]++;
+            listFinishes(found, drawn, hardTotal + (ace ? 1 : v + 2), hasAce || ace, numCards + 1);
+            drawn[v]--;
         }
-        return 0.0;
     }
-    
-    // Display
-    void displayStats() const{
-        cout << "\n===== PLAYER STATS =====\n";
 
-        if (m_playerStats.empty()){
-            cout << "No information available yet...go play! \n";
-            return;
+    const vector<DealerFinish>& finishesFor(int upValue){
+        vector<DealerFinish>& finishes = m_finishes[upValue - 2];
+        if (!finishes.empty()){
+            return finishes;
         }
-        cout << setw(15) << left << "Player"
-             << setw(10) << right << "Wins" 
-             << setw(10) << "Losses" 
-             << setw(10) << "Win Rate" << endl;
-        cout << "===========================================" << endl;
 
-        for (const auto& entry : m_playerStats){
-            string name = entry.first;
-            int wins = entry.second.first;
-            int losses = entry.second.second;
-            double winRate = 0;
+        map<pair<array<uint8_t, NUMVALUES>, uint8_t>, double> found;
+        array<uint8_t, NUMVALUES> drawn{};
+        bool ace = (upValue == 11);
+        listFinishes(found, drawn, ace ? 1 : upValue, ace, 1);
 
-            if (wins + losses > 0) {
-                winRate = static_cast<double>(wins) / (wins + losses) * 100.0;
+        for (const auto& entry : found){
+            DealerFinish finish{entry.second, entry.first.second, 0, 0, {}, {}};
+            for (int v = 0; v < NUMVALUES; v++){
+                if (entry.first.first[v]){
+                    finish.value[finish.parts] = static_cast<uint8_t>(v);
+                    finish.count[finish.parts] = entry.first.first[v];
+                    finish.parts++;
+                    finish.cards += entry.first.first[v];
+                }
             }
-            cout << setw(15) << left << name 
-                 << setw(10) << right << wins 
-                 << setw(10) << losses 
-                 << setw(9) << fixed << setprecision(1) << winRate << "%" << endl;
+            finishes.push_back(finish);
         }
-        
+        return finishes;
     }
 
-    void displayHighScores(int top = 5) const{
-
-        cout << "\n===== HIGH SCORES =====\n";
+    /*
+        the chance of one particular order of k cards coming out of shoe is the product of each value's
+        falling factorial over the shoe's, so everything the sum needs is in two small tables. a finish
+        the shoe doesn't have the cards for comes out as 0, and whatever's left over is the shoe running
+        dry before the dealer is done.
+    */
+    DealerDistribution dealerFrom(const ShoeComposition& shoe, int upValue){
+        DealerDistribution dist;
+        int remaining = compositionSize(shoe);
 
-        if (m_highScores.empty()){
-            cout << "No highscores available yet...go win! (or don't)\n";
-            return;
+        array<array<double, MAXHANDCARDS + 1>, NUMVALUES> falling;
+        array<double, MAXHANDCARDS + 1> perOrder;
+        perOrder[0] = 1.0;
+        for (int k = 1; k <= MAXHANDCARDS; k++){
+            perOrder[k] = k <= remaining ? perOrder[k - 1] / (remaining - k + 1) : 0.0;
+        }
+        for (int v = 0; v < NUMVALUES; v++){
+            falling[v][0] = 1.0;
+            for (int k = 1; k <= MAXHANDCARDS; k++){
+                falling[v][k] = falling[v][k - 1] * max(static_cast<int>(shoe[v]) - k + 1, 0);
+            }
         }
-        cout << setw(15) << left << "Rank"
-             << setw(10) << right << "Player" 
-             << setw(10) << "Money" << endl;
-        cout << "===========================================" << endl;
 
-        int r = 1;
-        for (auto dS = m_highScores.rbegin() ; dS != m_highScores.rend() ; dS++, r++) {
-            cout << setw(5) << right << r << "."
-            << setw(15) << left << dS->second
-            << "$" << setw(9) << right << dS->first << endl;
+        double finished = 0.0;
+        for (const DealerFinish& finish : finishesFor(upValue)){
+            double p = finish.orders * perOrder[finish.cards];
+            for (int i = 0; i < finish.parts; i++){
+                p *= falling[finish.value[i]][finish.count[i]];
+            }
+            dist.p[finish.result] += p;
+            finished += p;
         }
+        dist.p[DEALER_LOW] = max(1.0 - finished, 0.0);
+        return dist;
     }
-};
 
+    //Best of standing or hitting again, for a player hand that hasn't busted.
+    double bestFrom(ShoeComposition& shoe, int hardTotal, bool hasAce, int upValue){
+        return max(evStand(shoe, softTotal(hardTotal, hasAce), upValue), evHit(shoe, hardTotal, hasAce, upValue));
+    }
 
-class Game : public GameStats{
 public:
     /*
-    used to make a COPY of the player to use during run.
+        what a player can do with the hand in front of them and what each is worth, in original bets.
+        anything that isn't on offer is left at NOTOFFERED so it never comes out best.
     */
-    deque<unique_ptr<Player>> m_players;
-    Dealer m_dealer;
-    GameStats m_stats;
-    queue<string> m_actionLog;
-    priority_queue<pair<int, string>> m_events;
-    
+    struct Decision {
+        static constexpr double NOTOFFERED = -numeric_limits<double>::infinity();
+
+        double stand = NOTOFFERED;
+        double hit = NOTOFFERED;
+        double doubleDown = NOTOFFERED;
+        double split = NOTOFFERED;
+        double surrender = NOTOFFERED;
+        Action best = Action::STAND;
+
+        double bestEv() const{
+            return max({stand, hit, doubleDown, split, surrender});
+        }
+    };
+
     /*
-    
-    flag class for game flow logic, will be of help with flow chart design and game loop.
-    
+        peeked engines price decisions the way this table plays them, after the dealer has checked a 10 or
+        ace for blackjack, so the dealer's odds are taken as given no blackjack. the player's own draws
+        aren't conditioned on the hole card, which is the usual shortcut and worth well under 0.1%.
+        rules decide how the dealer plays and what the player is allowed to do, so an engine (and its
+        cache) belongs to one rule set.
     */
-    enum class GameState { BETTING, DEALING, PLAYER_TURN, DEALER_TURN, PAYOUT, CLEANUP };
-    GameState m_currentState;
-    
-    // Maps for card values and suits
-    map<string, int> m_cardValues;
-    map<string, string> m_suitNames;
-    
-    Game() : m_currentState(GameState::BETTING){
-        m_cardValues["2"] = 2;
-        m_cardValues["3"] = 3;
-        m_cardValues["4"] = 4;
-        m_cardValues["5"] = 5;
-        m_cardValues["6"] = 6;
-        m_cardValues["7"] = 7;
-        m_cardValues["8"] = 8;
-        m_cardValues["9"] = 9;
-        m_cardValues["10"] = 10;
-        m_cardValues["Jack"] = 10;
-        m_cardValues["Queen"] = 10;
-        m_cardValues["King"] = 10;
-        m_cardValues["Ace"] = 11; 
-
-        //suits for game flow
-        m_suitNames["HEARTS"] = "HEARTS";
-        m_suitNames["DIAMONDS"] = "DIAMONDS";
-        m_suitNames["CLUBS"] = "CLUBS";
-        m_suitNames["SPADES"] = "SPADES";
+    explicit DealerOddsEngine(bool peeked = false, const TableRules& rules = TableRules()) : m_peeked(peeked), m_rules(rules){}
+
+    /*
+        distribution of the dealer's final hand showing upValue (2-11, ace = 11). shoe is every card
+        still unseen, so the upcard has already been taken out of it.
+    */
+    DealerDistribution dealerOutcomes(const ShoeComposition& shoe, int upValue){
+        StateKey key{shoe, 0, 0, static_cast<uint8_t>(upValue)};
+        auto found = m_dealerMemo.find(key);
+        if (found != m_dealerMemo.end()){
+            return found->second;
+        }
+        DealerDistribution dist = dealerFrom(shoe, upValue);
+        m_dealerMemo.emplace(key, dist);
+        return dist;
     }
-    
-    // Player management
-    void addPlayer(const Player& name){
-        m_players.push_back(make_unique<Player>(name));
-        logAction(name.getName() + " joined the game.");
+
+    /*
+        expected value, in bets, of standing on playerTotal against upValue.
+        a dealer blackjack beats anything here, player blackjacks get settled before this matters.
+    */
+    double evStand(const ShoeComposition& shoe, int playerTotal, int upValue){
+        if (playerTotal > 21){
+            return -1.0;
+        }
+        DealerDistribution dist = dealerOutcomes(shoe, upValue);
+        if (m_peeked && dist.p[DEALER_BLACKJACK] > 0.0 && dist.p[DEALER_BLACKJACK] < 1.0){
+            double noBlackjack = 1.0 - dist.p[DEALER_BLACKJACK];
+            for (double& p : dist.p){
+                p /= noBlackjack;
+            }
+            dist.p[DEALER_BLACKJACK] = 0.0;
+        }
+
+        double ev = dist.p[DEALER_BUST] - dist.p[DEALER_BLACKJACK];
+        for (int r = DEALER_LOW; r <= DEALER_21; r++){
+            int dealerTotal = (r == DEALER_LOW) ? 16 : 17 + (r - DEALER_17);
+            if (playerTotal > dealerTotal){
+                ev += dist.p[r];
+            }
+            else if (playerTotal < dealerTotal){
+                ev -= dist.p[r];
+            }
+        }
+        return ev;
     }
+
     /*
-        use find_if function to search through the deque of unique pointers and return the player pointer if
-        the getName() matches the targeted name. afterwards, check to see where the returned player is, and remove it
-        log against for better game flow.
+        expected value of taking one more card and then playing on perfectly (hit or stand, whichever is
+        better each time). the player's own draws come out of the shoe before the dealer plays.
     */
-    void removePlayer(const string& name){
-        auto rP = find_if(m_players.begin(), m_players.end(), [&name](const unique_ptr<Player>&p) 
-        {return p->getName() == name;}
-        );
+    double evHit(const ShoeComposition& shoe, int hardTotal, bool hasAce, int upValue){
+        StateKey key{shoe, static_cast<uint8_t>(hardTotal), static_cast<uint8_t>(hasAce), static_cast<uint8_t>(upValue)};
+        auto found = m_hitMemo.find(key);
+        if (found != m_hitMemo.end()){
+            return found->second;
+        }
 
-        if (rP != m_players.end()){
-            logAction((*rP)->getName() + "has forfeited.");
-            m_players.erase(rP);
+        ShoeComposition work = shoe;
+        int remaining = compositionSize(work);
+        if (remaining == 0){
+            return evStand(shoe, softTotal(hardTotal, hasAce), upValue);
         }
+
+        double ev = 0.0;
+        for (int v = 0; v < NUMVALUES; v++){
+            if (work[v] == 0){
+                continue;
+            }
+            double weight = static_cast<double>(work[v]) / remaining;
+            bool ace = (v == NUMVALUES - 1);
+            int nextHard = hardTotal + (ace ? 1 : v + 2);
+
+            work[v]--;
+            ev += weight * (nextHard > 21 ? -1.0 : bestFrom(work, nextHard, hasAce || ace, upValue));
+            work[v]++;
+        }
+
+        m_hitMemo.emplace(key, ev);
+        return ev;
     }
 
+    //Exactly one more card for twice the bet, then standing on whatever it makes.
+    double evDouble(const ShoeComposition& shoe, int hardTotal, bool hasAce, int upValue){
+        ShoeComposition work = shoe;
+        int remaining = compositionSize(work);
+        if (remaining == 0){
+            return 2.0 * evStand(shoe, softTotal(hardTotal, hasAce), upValue);
+        }
 
-    
-    // magnum opus
-    void play(){
-        if (m_players.empty()){
-            cout << "No players at table.\n";
+        double ev = 0.0;
+        for (int v = 0; v < NUMVALUES; v++){
+            if (work[v] == 0){
+                continue;
+            }
+            double weight = static_cast<double>(work[v]) / remaining;
+            bool ace = (v == NUMVALUES - 1);
+            int nextHard = hardTotal + (ace ? 1 : v + 2);
+
+            work[v]--;
+            ev += weight * (nextHard > 21 ? -1.0 : evStand(work, softTotal(nextHard, hasAce || ace), upValue));
+            work[v]++;
+        }
+        return 2.0 * ev;
+    }
+
+    /*
+        splitting a pair of pairValue (2-11), with both of its cards already out of shoe. each half draws
+        its second card and is played on the way the table allows: stand, hit, or double if the rules
+        allow it after a split, and split aces get that one card only. both halves are priced off the same shoe and resplits are
+        left out, which between them move the answer by a few hundredths of a percent.
+    */
+    double evSplit(const ShoeComposition& shoe, int pairValue, int upValue){
+        ShoeComposition work = shoe;
+        int remaining = compositionSize(work);
+        bool aces = (pairValue == 11);
+        int startHard = aces ? 1 : pairValue;
+        if (remaining == 0){
+            return 2.0 * evStand(shoe, softTotal(startHard, aces), upValue);
+        }
+
+        double ev = 0.0;
+        for (int v = 0; v < NUMVALUES; v++){
+            if (work[v] == 0){
+                continue;
+            }
+            double weight = static_cast<double>(work[v]) / remaining;
+            bool ace = (v == NUMVALUES - 1);
+            int nextHard = startHard + (ace ? 1 : v + 2);
+            bool hasAce = aces || ace;
+
+            work[v]--;
+            int total = softTotal(nextHard, hasAce);
+            double half = evStand(work, total, upValue);
+            if (!aces){
+                half = max(half, evHit(work, nextHard, hasAce, upValue));
+                if (m_rules.canDoubleOn(total, true)){
+                    half = max(half, evDouble(work, nextHard, hasAce, upValue));
+                }
+            }
+            ev += weight * half;
+            work[v]++;
+        }
+        return 2.0 * ev;
+    }
+
+    /*
+        every option on a hand worth hardTotal/hasAce (pairValue 0 if it isn't a pair) and the one worth the
+        most. shoe is what's unseen, so the player's cards and the upcard are already out of it. the can*
+        flags are the seat's own situation (money, hands), the rules are taken into account on top.
+    */
+    Decision decide(const ShoeComposition& shoe, int hardTotal, bool hasAce, int pairValue, int upValue,
+                    bool canDouble = true, bool canSplit = true, bool canSurrender = false){
+        Decision d;
+        int total = softTotal(hardTotal, hasAce);
+        d.stand = evStand(shoe, total, upValue);
+        d.hit = evHit(shoe, hardTotal, hasAce, upValue);
+        if (canDouble && m_rules.canDoubleOn(total, false)){
+            d.doubleDown = evDouble(shoe, hardTotal, hasAce, upValue);
+        }
+        if (canSplit && pairValue != 0 && m_rules.maxHands > 1){
+            d.split = evSplit(shoe, pairValue, upValue);
+        }
+        if (canSurrender && m_rules.lateSurrender){
+            d.surrender = -0.5;
+        }
+
+        //Ties go to the simpler play.
+        double best = d.stand;
+        if (d.hit > best){
+            best = d.hit;
+            d.best = Action::HIT;
+        }
+        if (d.doubleDown > best){
+            best = d.doubleDown;
+            d.best = Action::DOUBLE;
+        }
+        if (d.split > best){
+            best = d.split;
+            d.best = Action::SPLIT;
+        }
+        if (d.surrender > best){
+            d.best = Action::SURRENDER;
+        }
+        return d;
+    }
+
+    //Same as above, straight off a Hand.
+    double evStand(const ShoeComposition& shoe, const Hand& hand, int upValue){
+        return evStand(shoe, hand.getTotal(), upValue);
+    }
+    double evHit(const ShoeComposition& shoe, const Hand& hand, int upValue){
+        return evHit(shoe, hand.getHardTotal(), hand.hasAce(), upValue);
+    }
+    double evDouble(const ShoeComposition& shoe, const Hand& hand, int upValue){
+        return evDouble(shoe, hand.getHardTotal(), hand.hasAce(), upValue);
+    }
+    Decision decide(const ShoeComposition& shoe, const Hand& hand, int upValue, bool canDouble = true, bool canSplit = true,
+                    bool canSurrender = false){
+        int pairValue = hand.isPair() ? hand.begin()->getValue() : 0;
+        return decide(shoe, hand.getHardTotal(), hand.hasAce(), pairValue, upValue, canDouble, canSplit, canSurrender);
+    }
+
+    void clear(){
+        m_dealerMemo.clear();
+        m_hitMemo.clear();
+    }
+    size_t cacheSize() const{
+        return m_dealerMemo.size() + m_hitMemo.size();
+    }
+};
+
+
+/*
+    how a hand settled against the dealer. the values double as the multiple of the bet the player
+    is up, apart from OUTCOME_BLACKJACK which pays whatever the table's blackjack payout is.
+*/
+enum HandOutcome : int32_t { OUTCOME_LOSS = -1, OUTCOME_PUSH = 0, OUTCOME_WIN = 1, OUTCOME_BLACKJACK = 2 };
+
+//The payout ladder for a single hand, in the order a dealer would read it off the table.
+inline HandOutcome settleHand(int playerTotal, bool playerBlackjack, int dealerTotal, bool dealerBlackjack){
+    if (playerTotal > 21){
+        return OUTCOME_LOSS;
+    }
+    if (playerBlackjack && !dealerBlackjack){
+        return OUTCOME_BLACKJACK;
+    }
+    if (dealerTotal > 21){
+        return OUTCOME_WIN;
+    }
+    if (dealerBlackjack && !playerBlackjack){
+        return OUTCOME_LOSS;
+    }
+    if (playerTotal > dealerTotal){
+        return OUTCOME_WIN;
+    }
+    if (playerTotal < dealerTotal){
+        return OUTCOME_LOSS;
+    }
+    return OUTCOME_PUSH;
+}
+
+/*
+    HandBatch holds hands waiting to be settled as a structure of arrays, one array per field, so
+    settleHands() can go down thousands of them (from as many tables as you like) in one straight loop.
+    flags are int32 like everything else so every array steps at the same width.
+*/
+struct HandBatch {
+    pmr::vector<int32_t> playerTotal;
+    pmr::vector<int32_t> playerBlackjack; // 0 or 1
+    pmr::vector<int32_t> dealerTotal;
+    pmr::vector<int32_t> dealerBlackjack;
+    pmr::vector<int32_t> bet;
+
+    //Filled in by settleHands().
+    pmr::vector<int32_t> outcome; // a HandOutcome
+    pmr::vector<int32_t> net;     // what the player is up on the hand, negative when they lost
+
+    //A table's batch takes its memory from the table's arena, anyone else's from the heap.
+    explicit HandBatch(pmr::memory_resource* memory = pmr::get_default_resource())
+        : playerTotal(memory), playerBlackjack(memory), dealerTotal(memory), dealerBlackjack(memory),
+          bet(memory), outcome(memory), net(memory){}
+
+    size_t size() const{
+        return bet.size();
+    }
+    //Makes room for hands up front, so filling the batch later never has to grow it.
+    void reserve(size_t hands){
+        playerTotal.reserve(hands);
+        playerBlackjack.reserve(hands);
+        dealerTotal.reserve(hands);
+        dealerBlackjack.reserve(hands);
+        bet.reserve(hands);
+        outcome.reserve(hands);
+        net.reserve(hands);
+    }
+    //Empties the batch but keeps the arrays' memory for the next one.
+    void clear(){
+        playerTotal.clear();
+        playerBlackjack.clear();
+        dealerTotal.clear();
+        dealerBlackjack.clear();
+        bet.clear();
+        outcome.clear();
+        net.clear();
+    }
+    void add(int pTotal, bool pBlackjack, int dTotal, bool dBlackjack, int wager){
+        playerTotal.push_back(pTotal);
+        playerBlackjack.push_back(pBlackjack);
+        dealerTotal.push_back(dTotal);
+        dealerBlackjack.push_back(dBlackjack);
+        bet.push_back(wager);
+    }
+};
+
+/*
+    what a natural wins on a bet, one specialization per payout a table can offer. all three are whole
+    number math the settle loop can vectorize, where a runtime multiplier goes through a double and back
+    for every hand. odd dollars round down the same way the double version's cast does.
+*/
+template <BlackjackPayout Pays>
+struct NaturalPayout;
+
+template <>
+struct NaturalPayout<BlackjackPayout::THREE_TO_TWO> {
+    int32_t operator()(int32_t bet) const{
+        return bet + bet / 2;
+    }
+};
+template <>
+struct NaturalPayout<BlackjackPayout::SIX_TO_FIVE> {
+    int32_t operator()(int32_t bet) const{
+        return bet + bet / 5;
+    }
+};
+template <>
+struct NaturalPayout<BlackjackPayout::EVEN_MONEY> {
+    int32_t operator()(int32_t bet) const{
+        return bet;
+    }
+};
+
+/*
+    settles n hands, giving the same answers as settleHand() without a single branch: each rung of
+    the ladder is a 0/1 mask that overwrites the result of the rungs below it, working up from the
+    plain comparison to the player's bust. naturalPays(bet) is what a natural wins.
+
+    the arrays are restrict so the compiler knows none of them overlap and can vectorize the loop
+    without checking (-O3 or -ftree-vectorize).
+*/
+template <typename NaturalPays>
+inline void settleHandsWith(const int32_t* __restrict pTotal, const int32_t* __restrict pBlackjack,
+                            const int32_t* __restrict dTotal, const int32_t* __restrict dBlackjack,
+                            const int32_t* __restrict bet, int32_t* __restrict outcome, int32_t* __restrict net,
+                            size_t n, NaturalPays naturalPays){
+    for (size_t i = 0; i < n; i++){
+        int32_t playerBust = pTotal[i] > 21;
+        int32_t dealerBust = dTotal[i] > 21;
+        int32_t natural = pBlackjack[i] & (dBlackjack[i] ^ 1);
+        int32_t beatenByNatural = dBlackjack[i] & (pBlackjack[i] ^ 1);
+
+        int32_t result = (pTotal[i] > dTotal[i]) - (pTotal[i] < dTotal[i]);
+        result += beatenByNatural * (OUTCOME_LOSS - result);
+        result += dealerBust * (OUTCOME_WIN - result);
+        result += natural * (OUTCOME_BLACKJACK - result);
+        result += playerBust * (OUTCOME_LOSS - result);
+        outcome[i] = result;
+
+        int32_t evenMoney = result * bet[i];
+        int32_t naturalNet = naturalPays(bet[i]);
+        net[i] = evenMoney + natural * (naturalNet - evenMoney);
+    }
+}
+//Any payout at all, blackjackPays being what a natural wins per unit bet.
+inline void settleHands(const int32_t* __restrict pTotal, const int32_t* __restrict pBlackjack,
+                        const int32_t* __restrict dTotal, const int32_t* __restrict dBlackjack,
+                        const int32_t* __restrict bet, int32_t* __restrict outcome, int32_t* __restrict net,
+                        size_t n, double blackjackPays){
+    settleHandsWith(pTotal, pBlackjack, dTotal, dBlackjack, bet, outcome, net, n, [blackjackPays](int32_t wager){
+        return static_cast<int32_t>(wager * blackjackPays);
+    });
+}
+template <typename NaturalPays>
+inline void settleBatch(HandBatch& batch, NaturalPays naturalPays){
+    size_t n = batch.size();
+    batch.outcome.resize(n);
+    batch.net.resize(n);
+    settleHandsWith(batch.playerTotal.data(), batch.playerBlackjack.data(), batch.dealerTotal.data(), batch.dealerBlackjack.data(),
+                    batch.bet.data(), batch.outcome.data(), batch.net.data(), n, naturalPays);
+}
+inline void settleHands(HandBatch& batch, double blackjackPays){
+    settleBatch(batch, [blackjackPays](int32_t wager){
+        return static_cast<int32_t>(wager * blackjackPays);
+    });
+}
+//One of the table payouts, picked once for the whole batch.
+inline void settleHands(HandBatch& batch, BlackjackPayout pays){
+    switch (pays){
+        case BlackjackPayout::THREE_TO_TWO:
+            settleBatch(batch, NaturalPayout<BlackjackPayout::THREE_TO_TWO>());
+            break;
+        case BlackjackPayout::SIX_TO_FIVE:
+            settleBatch(batch, NaturalPayout<BlackjackPayout::SIX_TO_FIVE>());
+            break;
+        case BlackjackPayout::EVEN_MONEY:
+            settleBatch(batch, NaturalPayout<BlackjackPayout::EVEN_MONEY>());
+            break;
+    }
+}
+
+
+/*
+    mean and variance of a stream of numbers in constant memory, Welford's way so long runs don't lose
+    precision subtracting big sums. two of them merge exactly (Chan's pairwise update), which is how
+    simulation workers combine theirs, and the confidence interval can be read off at any point.
+*/
+class RunningStats {
+private:
+    long long m_count;
+    double m_mean;
+    double m_m2; // sum of squared differences from the mean
+    double m_min;
+    double m_max;
+
+public:
+    RunningStats() : m_count(0), m_mean(0.0), m_m2(0.0), m_min(0.0), m_max(0.0){}
+
+    void add(double x){
+        m_count++;
+        double delta = x - m_mean;
+        m_mean += delta / m_count;
+        m_m2 += delta * (x - m_mean);
+        m_min = m_count == 1 ? x : min(m_min, x);
+        m_max = m_count == 1 ? x : max(m_max, x);
+    }
+    void merge(const RunningStats& other){
+        if (!other.m_count){
             return;
         }
+        if (!m_count){
+            *this = other;
+            return;
+        }
+        long long count = m_count + other.m_count;
+        double delta = other.m_mean - m_mean;
+        m_mean += delta * other.m_count / count;
+        m_m2 += other.m_m2 + delta * delta * (static_cast<double>(m_count) * other.m_count / count);
+        m_count = count;
+        m_min = min(m_min, other.m_min);
+        m_max = max(m_max, other.m_max);
+    }
 
-        m_dealer.shuffleDeck();
-        logAction("Dealer shuffles the deck.");
+    long long count() const{
+        return m_count;
+    }
+    double mean() const{
+        return m_mean;
+    }
+    //Sample variance, 0 until there are two numbers.
+    double variance() const{
+        return m_count > 1 ? m_m2 / (m_count - 1) : 0.0;
+    }
+    double stddev() const{
+        return sqrt(variance());
+    }
+    double standardError() const{
+        return m_count ? sqrt(variance() / m_count) : 0.0;
+    }
+    //Half width of the 95% confidence interval on the mean.
+    double margin95() const{
+        return 1.96 * standardError();
+    }
+    double minimum() const{
+        return m_min;
+    }
+    double maximum() const{
+        return m_max;
+    }
+};
 
-        bool contPlay = true;
-        while(contPlay){
-            setState(GameState::BETTING);
-            placeBets();
+/*
+    a ratio of two streams' sums (net over wagered, which is what the house edge is) with a confidence
+    interval, by the delta method off the same pairwise Welford updates plus their co-moment. hands with
+    bigger bets count for more, just like they do in the edge itself. seats at one table share the dealer's
+    hand, so with a full table the interval comes out a bit narrower than it really is.
+*/
+class RatioStats {
+private:
+    long long m_count;
+    double m_meanX;
+    double m_meanY;
+    double m_m2x;
+    double m_m2y;
+    double m_cxy; // sum of (x - meanX)(y - meanY)
+
+public:
+    RatioStats() : m_count(0), m_meanX(0.0), m_meanY(0.0), m_m2x(0.0), m_m2y(0.0), m_cxy(0.0){}
 
-            setState(GameState::DEALING);
-            deal();
+    void add(double x, double y){
+        m_count++;
+        double dx = x - m_meanX;
+        double dy = y - m_meanY;
+        m_meanX += dx / m_count;
+        m_meanY += dy / m_count;
+        m_m2x += dx * (x - m_meanX);
+        m_m2y += dy * (y - m_meanY);
+        m_cxy += dx * (y - m_meanY);
+    }
+    void merge(const RatioStats& other){
+        if (!other.m_count){
+            return;
+        }
+        if (!m_count){
+            *this = other;
+            return;
+        }
+        long long count = m_count + other.m_count;
+        double dx = other.m_meanX - m_meanX;
+        double dy = other.m_meanY - m_meanY;
+        double weight = static_cast<double>(m_count) * other.m_count / count;
+        m_meanX += dx * other.m_count / count;
+        m_meanY += dy * other.m_count / count;
+        m_m2x += other.m_m2x + dx * dx * weight;
+        m_m2y += other.m_m2y + dy * dy * weight;
+        m_cxy += other.m_cxy + dx * dy * weight;
+        m_count = count;
+    }
+
+    long long count() const{
+        return m_count;
+    }
+    double ratio() const{
+        return m_meanY != 0.0 ? m_meanX / m_meanY : 0.0;
+    }
+    //Half width of the 95% confidence interval on ratio().
+    double margin95() const{
+        if (m_count < 2 || m_meanY == 0.0){
+            return 0.0;
+        }
+        double r = ratio();
+        double spread = (m_m2x - 2.0 * r * m_cxy + r * r * m_m2y) / (m_count - 1);
+        return 1.96 * sqrt(max(spread, 0.0) / m_count) / fabs(m_meanY);
+    }
+};
+
+/*
+    quantiles of a stream of non negative numbers (bankrolls, drawdowns) in a fixed 9K, any quantile
+    to within 1% of the real value. every number lands in a log bucket gamma^(i-1) < x <= gamma^i with
+    gamma = 1.01/0.99, a bucket's midpoint is within 1% of everything in it, and anything up to INT_MAX
+    fits. buckets are counts, so sketches merge by adding them up, in any order.
+*/
+class QuantileSketch {
+private:
+    static constexpr double ACCURACY = 0.01;
+    static constexpr double GAMMA = (1.0 + ACCURACY) / (1.0 - ACCURACY);
+    static const int BUCKETS = 1088; // log(INT_MAX) / log(GAMMA) is about 1074.3, so INT_MAX lands in bucket 1 + 1075
 
-            setState(GameState::PLAYER_TURN);
-            playerTurns();
+    array<uint64_t, BUCKETS> m_buckets; // [0] holds everything below 1
+    uint64_t m_count;
+    double m_min;
+    double m_max;
 
-            setState(GameState::DEALER_TURN);
-            dealerTurn();
+    static int bucket(double x){
+        if (x < 1.0){
+            return 0;
+        }
+        static const double LOGGAMMA = log(GAMMA);
+        return min(BUCKETS - 1, 1 + static_cast<int>(ceil(log(x) / LOGGAMMA)));
+    }
 
-            setState(GameState::PAYOUT);
-            payouts();
+public:
+    QuantileSketch() : m_count(0), m_min(0.0), m_max(0.0){
+        m_buckets.fill(0);
+    }
 
-            setState(GameState::CLEANUP);
-            cleanup();
-            findMinMaxMoney();
+    void add(double x){
+        x = max(x, 0.0);
+        m_buckets[bucket(x)]++;
+        m_min = m_count ? min(m_min, x) : x;
+        m_max = m_count ? max(m_max, x) : x;
+        m_count++;
+    }
+    void merge(const QuantileSketch& other){
+        if (!other.m_count){
+            return;
+        }
+        for (int i = 0; i < BUCKETS; i++){
+            m_buckets[i] += other.m_buckets[i];
+        }
+        m_min = m_count ? min(m_min, other.m_min) : other.m_min;
+        m_max = m_count ? max(m_max, other.m_max) : other.m_max;
+        m_count += other.m_count;
+    }
 
-            cout << "\nContinue playing? (y/n):" ;
-            char gChoice;
-            cin >> gChoice;
-            cin.ignore(numeric_limits<streamsize>::max(), '\n');
-            contPlay = (gChoice == 'y' || gChoice == 'Y');
+    uint64_t count() const{
+        return m_count;
+    }
+    //The q quantile (0-1). the ends come back exact, everything in between to within 1%.
+    double quantile(double q) const{
+        if (!m_count){
+            return 0.0;
+        }
+        if (q <= 0.0){
+            return m_min;
         }
+        if (q >= 1.0){
+            return m_max;
+        }
+        uint64_t rank = static_cast<uint64_t>(q * (m_count - 1));
+        uint64_t seen = 0;
+        for (int i = 0; i < BUCKETS; i++){
+            seen += m_buckets[i];
+            if (seen > rank){
+                double estimate = i == 0 ? 0.0 : 2.0 * pow(GAMMA, i - 1) / (GAMMA + 1.0);
+                return min(max(estimate, m_min), m_max);
+            }
+        }
+        return m_max;
+    }
+};
+
+
+/*
+    per seat counters. unlike the name keyed map these are plain sums in a vector indexed by seat,
+    so stats from separate tables line up and merge by just adding them together.
+*/
+struct SeatRecord {
+    long long wins = 0;
+    long long losses = 0;
+    long long pushes = 0;
+    long long wagered = 0;
+    long long net = 0;
+
+    void merge(const SeatRecord& other){
+        wins += other.wins;
+        losses += other.losses;
+        pushes += other.pushes;
+        wagered += other.wagered;
+        net += other.net;
+    }
+};
+
+/*
+    Leaderboard keeps every player ordered by money (richest first, ties broken by name the same way
+    the old set<pair<int,string>> did) in a treap where each node knows the size of its subtree.
+    alongside it, a name -> node index finds a player's current entry straight away.
+
+    that makes an update (drop the old entry, insert the new one) O(log n) instead of scanning
+    everybody, gives real top-K listings, and lets rank lookups count their way down the tree.
+    nodes live in a vector and freed ones get reused, so steady updates don't allocate.
+*/
+class Leaderboard {
+private:
+    struct Node {
+        int money;
+        string name;
+        uint32_t priority;
+        int left;
+        int right;
+        int size;
+    };
+
+    vector<Node> m_nodes;
+    vector<int> m_free;
+    unordered_map<string, int> m_index;
+    int m_root;
+    minstd_rand m_priorities;
+
+    int sizeOf(int n) const{
+        return n < 0 ? 0 : m_nodes[n].size;
+    }
+    void pull(int n){
+        m_nodes[n].size = 1 + sizeOf(m_nodes[n].left) + sizeOf(m_nodes[n].right);
+    }
+    //True if node n belongs strictly ahead of (money, name) on the board.
+    bool ahead(int n, int money, const string& name) const{
+        const Node& node = m_nodes[n];
+        return node.money != money ? node.money > money : node.name > name;
+    }
+
+    //Splits tree t into everything ahead of (money, name) and everything else.
+    void split(int t, int money, const string& name, int& before, int& after){
+        if (t < 0){
+            before = after = -1;
+            return;
+        }
+        if (ahead(t, money, name)){
+            split(m_nodes[t].right, money, name, m_nodes[t].right, after);
+            before = t;
+        }
+        else{
+            split(m_nodes[t].left, money, name, before, m_nodes[t].left);
+            after = t;
+        }
+        pull(t);
+    }
+    int merge(int a, int b){
+        if (a < 0 || b < 0){
+            return a < 0 ? b : a;
+        }
+        if (m_nodes[a].priority > m_nodes[b].priority){
+            m_nodes[a].right = merge(m_nodes[a].right, b);
+            pull(a);
+            return a;
+        }
+        m_nodes[b].left = merge(a, m_nodes[b].left);
+        pull(b);
+        return b;
+    }
 
+    //Unlinks node n from the tree, leaving it free to be relinked.
+    void detach(int n){
+        int before, rest, self, after;
+        split(m_root, m_nodes[n].money, m_nodes[n].name, before, rest);
+        //Everything in rest is node n or behind it, so peel off the single leftmost entry.
+        splitFirst(rest, self, after);
+        m_root = merge(before, after);
+    }
+    void splitFirst(int t, int& first, int& rest){
+        if (m_nodes[t].left < 0){
+            first = t;
+            rest = m_nodes[t].right;
+            m_nodes[t].right = -1;
+            pull(t);
+            return;
+        }
+        splitFirst(m_nodes[t].left, first, m_nodes[t].left);
+        rest = t;
+        pull(t);
+    }
+    void attach(int n){
+        int before, after;
+        split(m_root, m_nodes[n].money, m_nodes[n].name, before, after);
+        m_root = merge(merge(before, n), after);
+    }
+
+    template <class Visitor>
+    bool walk(int n, int& remaining, Visitor& visit) const{
+        if (n < 0 || remaining <= 0){
+            return remaining > 0;
+        }
+        if (!walk(m_nodes[n].left, remaining, visit) || remaining <= 0){
+            return false;
+        }
+        visit(m_nodes[n].name, m_nodes[n].money);
+        remaining--;
+        return walk(m_nodes[n].right, remaining, visit);
+    }
+
+public:
+    Leaderboard() : m_root(-1), m_priorities(2025){}
+
+    //Sets a player's money, adding them to the board if they're new.
+    void update(const string& name, int money){
+        auto found = m_index.find(name);
+        if (found != m_index.end()){
+            int n = found->second;
+            if (m_nodes[n].money == money){
+                return;
+            }
+            detach(n);
+            m_nodes[n].money = money;
+            m_nodes[n].left = m_nodes[n].right = -1;
+            m_nodes[n].size = 1;
+            attach(n);
+            return;
+        }
+
+        int n;
+        if (!m_free.empty()){
+            n = m_free.back();
+            m_free.pop_back();
+            m_nodes[n] = Node{money, name, static_cast<uint32_t>(m_priorities()), -1, -1, 1};
+        }
+        else{
+            n = static_cast<int>(m_nodes.size());
+            m_nodes.push_back(Node{money, name, static_cast<uint32_t>(m_priorities()), -1, -1, 1});
+        }
+        m_index.emplace(name, n);
+        attach(n);
+    }
+
+    void remove(const string& name){
+        auto found = m_index.find(name);
+        if (found == m_index.end()){
+            return;
+        }
+        detach(found->second);
+        m_free.push_back(found->second);
+        m_index.erase(found);
+    }
+
+    //1 for the richest player, 0 if the name isn't on the board.
+    int rank(const string& name) const{
+        auto found = m_index.find(name);
+        if (found == m_index.end()){
+            return 0;
+        }
+        const Node& target = m_nodes[found->second];
+        int aheadCount = 0;
+        int n = m_root;
+        while (n >= 0 && n != found->second){
+            if (ahead(n, target.money, target.name)){
+                aheadCount += sizeOf(m_nodes[n].left) + 1;
+                n = m_nodes[n].right;
+            }
+            else{
+                n = m_nodes[n].left;
+            }
+        }
+        return aheadCount + sizeOf(m_nodes[found->second].left) + 1;
+    }
+
+    //Calls visit(name, money) for the top k players, richest first.
+    template <class Visitor>
+    void top(int k, Visitor visit) const{
+        int remaining = k;
+        walk(m_root, remaining, visit);
+    }
+
+    int size() const{
+        return sizeOf(m_root);
+    }
+    bool empty() const{
+        return m_root < 0;
+    }
+};
+
+
+class GameStats {
+private:
+    unordered_map<string, pair<int, int>> m_playerStats; // <name, <wins, losses>>
+    Leaderboard m_highScores;
+    vector<SeatRecord> m_seatStats; // indexed by Player::getSeat()
+
+    //Table wide money totals, so simulations can work out the house edge.
+    long long m_handsPlayed;
+    long long m_totalWagered;
+    long long m_totalNet; // from the players' side, negative means the house is up
+
+    //Streaming aggregates, O(1) to update and the same size however long the table runs.
+    RunningStats m_handNet; // each hand's net in dollars
+    RatioStats m_edge; // net against wagered, hand by hand
+    QuantileSketch m_bankrolls; // every seat's money at the end of every round
+    array<SeatRecord, NUMUPCARDS> m_upcardStats; // hands by the dealer's upcard, 2 through 10 then the ace
+    
+public:
+
+    GameStats() : m_handsPlayed(0), m_totalWagered(0), m_totalNet(0){};
+    
+    void recordWin(const string& playerName){
+        m_playerStats[playerName].first++;
+    }
+    void recordLoss(const string& playerName){
+        m_playerStats[playerName].second++;
+    }
+    //Gives a new player a record to count into, so their first win or loss doesn't have to make one mid round.
+    void addPlayer(const string& playerName){
+        m_playerStats.emplace(playerName, make_pair(0, 0));
+    }
+    void recordBankroll(int money){
+        m_bankrolls.add(money);
+    }
+    //Picks a player's record back up from a saved profile.
+    void setRecord(const string& playerName, int wins, int losses){
+        m_playerStats[playerName] = make_pair(wins, losses);
+    }
+    //Side bets (insurance) count towards the money but aren't hands of their own.
+    void recordSideBet(int seat, int wager, int net){
+        m_totalWagered += wager;
+        m_totalNet += net;
+
+        if (seat >= static_cast<int>(m_seatStats.size())){
+            m_seatStats.resize(seat + 1);
+        }
+        m_seatStats[seat].wagered += wager;
+        m_seatStats[seat].net += net;
+    }
+    //UpValue is the dealer's upcard value, ace = 11.
+    void recordHand(int seat, int upValue, int wager, int net){
+        m_handsPlayed++;
+        m_totalWagered += wager;
+        m_totalNet += net;
+        m_handNet.add(net);
+        m_edge.add(net, wager);
+
+        SeatRecord& byUpcard = m_upcardStats[upValue - 2];
+        byUpcard.wagered += wager;
+        byUpcard.net += net;
+        (net > 0 ? byUpcard.wins : net < 0 ? byUpcard.losses : byUpcard.pushes)++;
+
+        if (seat >= static_cast<int>(m_seatStats.size())){
+            m_seatStats.resize(seat + 1);
+        }
+        SeatRecord& record = m_seatStats[seat];
+        record.wagered += wager;
+        record.net += net;
+        if (net > 0){
+            record.wins++;
+        }
+        else if (net < 0){
+            record.losses++;
+        }
+        else{
+            record.pushes++;
+        }
+    }
+
+    /*
+        folds another table's stats into this one. the counts and money are integer sums. the running
+        means and variances use the parallel Welford update, the edge's ratio sums the same way, and the
+        sketches add their bucket counts. the floating point parts depend on the order things are merged
+        in, so merging workers in a fixed order gives the same report no matter which thread finished first.
+    */
+    void merge(const GameStats& other){
+        for (const auto& entry : other.m_playerStats){
+            m_playerStats[entry.first].first += entry.second.first;
+            m_playerStats[entry.first].second += entry.second.second;
+        }
+        other.m_highScores.top(other.m_highScores.size(), [this](const string& name, int money){
+            updateHighScore(name, money);
+        });
+        if (other.m_seatStats.size() > m_seatStats.size()){
+            m_seatStats.resize(other.m_seatStats.size());
+        }
+        for (size_t i = 0; i < other.m_seatStats.size(); i++){
+            m_seatStats[i].merge(other.m_seatStats[i]);
+        }
+        m_handsPlayed += other.m_handsPlayed;
+        m_totalWagered += other.m_totalWagered;
+        m_totalNet += other.m_totalNet;
+        m_handNet.merge(other.m_handNet);
+        m_edge.merge(other.m_edge);
+        m_bankrolls.merge(other.m_bankrolls);
+        for (int i = 0; i < NUMUPCARDS; i++){
+            m_upcardStats[i].merge(other.m_upcardStats[i]);
+        }
+    }
+
+    /*
+
+        Updates high score by finding the player's entry through the leaderboard's name index
+        and moving it to wherever the new money puts it, O(log n) no matter how many players there are.
+    
+    */
+    void updateHighScore(const string& playerName, int money){
+        m_highScores.update(playerName, money);
+    }
+    //Where a player sits on the high score board, 1 being the richest. 0 if they aren't on it.
+    int getRank(const string& playerName) const{
+        return m_highScores.rank(playerName);
+    }
+    int getRankedPlayers() const{
+        return m_highScores.size();
+    }
+    
+    // Getters
+    int getWins(const string& playerName) const{
+        auto gW = m_playerStats.find(playerName);
+        if (gW != m_playerStats.end()){
+            return gW->second.first;
+        }
+        return 0;
+    }
+    int getLosses(const string& playerName) const{
+        auto gL = m_playerStats.find(playerName);
+        if (gL != m_playerStats.end()){
+            return gL->second.second;
+        }
+        return 0;
+    }
+    double getWinRate(const string& playerName) const{
+        auto gWR = m_playerStats.find(playerName);
+        if (gWR != m_playerStats.end()){
+            int wins = gWR->second.first;
+            int losses = gWR->second.second;
+            int total = wins + losses;
+            if (total > 0){
+            return static_cast<double>(wins) / total;
+            }
+        }
+        return 0.0;
+    }
+    const vector<SeatRecord>& getSeatStats() const{
+        return m_seatStats;
+    }
+    long long getHandsPlayed() const{
+        return m_handsPlayed;
+    }
+    long long getTotalWagered() const{
+        return m_totalWagered;
+    }
+    long long getTotalNet() const{
+        return m_totalNet;
+    }
+    //House edge is whatever the players lost, as a fraction of everything they bet.
+    double getHouseEdge() const{
+        if (m_totalWagered == 0){
+            return 0.0;
+        }
+        return -static_cast<double>(m_totalNet) / m_totalWagered;
+    }
+    //Half width of the 95% interval on getHouseEdge(), readable at any point in a run.
+    double getHouseEdgeMargin() const{
+        return m_edge.margin95();
+    }
+    const RunningStats& getHandNet() const{
+        return m_handNet;
+    }
+    const QuantileSketch& getBankrolls() const{
+        return m_bankrolls;
+    }
+    const array<SeatRecord, NUMUPCARDS>& getUpcardStats() const{
+        return m_upcardStats;
+    }
+    
+    // Display
+    void displayStats() const{
+        cout << "\n===== PLAYER STATS =====\n";
+
+        if (m_playerStats.empty()){
+            cout << "No information available yet...go play! \n";
+            return;
+        }
+        cout << setw(15) << left << "Player"
+             << setw(10) << right << "Wins" 
+             << setw(10) << "Losses" 
+             << setw(10) << "Win Rate" << endl;
+        cout << "===========================================" << endl;
+
+        for (const auto& entry : m_playerStats){
+            string name = entry.first;
+            int wins = entry.second.first;
+            int losses = entry.second.second;
+            double winRate = 0;
+
+            if (wins + losses > 0) {
+                winRate = static_cast<double>(wins) / (wins + losses) * 100.0;
+            }
+            cout << setw(15) << left << name 
+                 << setw(10) << right << wins 
+                 << setw(10) << losses 
+                 << setw(9) << fixed << setprecision(1) << winRate << "%" << endl;
+        }
+        
+    }
+
+    void displayHighScores(int top = 5) const{
+
+        cout << "\n===== HIGH SCORES =====\n";
+
+        if (m_highScores.empty()){
+            cout << "No highscores available yet...go win! (or don't)\n";
+            return;
+        }
+        cout << setw(15) << left << "Rank"
+             << setw(10) << right << "Player" 
+             << setw(10) << "Money" << endl;
+        cout << "===========================================" << endl;
+
+        int r = 1;
+        m_highScores.top(top, [&r](const string& name, int money){
+            cout << setw(5) << right << r++ << "."
+            << setw(15) << left << name
+            << "$" << setw(9) << right << money << endl;
+        });
+    }
+};
+
+
+/*
+    everything the action log can record. events are small fixed size structs, the text only gets
+    built when someone actually reads the log (the writer thread or displayActionLog()).
+*/
+enum class LogEventType : uint8_t {
+    JOINED, FORFEITED, OUT_OF_MONEY, SHUFFLED, BET, DEALT, HIT, DOUBLED, BLACKJACK, BUSTED, STOOD,
+    ALL_BUSTED, DEALER_HIT, DEALER_BUSTED, DEALER_STOOD, WON, LOST, PUSHED,
+    SPLIT, SURRENDERED, INSURED, INSURANCE_PAID, INSURANCE_LOST
+};
+
+//Seat number used for things the dealer (or the table as a whole) did.
+const int DEALER_SEAT = -1;
+
+struct LogEvent {
+    uint64_t round;
+    int32_t seat;
+    int32_t amount; // money for bets/payouts, hand total for stands/busts
+    LogEventType type;
+    Card card;
+};
+
+/*
+    ActionLog is a fixed size ring buffer of LogEvents, so memory stays the same however long the table runs.
+
+    with no writer attached it simply keeps the most recent CAPACITY events, overwriting the oldest.
+    startWriter() hands the buffer to a background thread that drains it into a text file. in that mode
+    the table never waits on the writer, if the writer falls a full buffer behind, new events are dropped
+    and counted instead.
+
+    only the table's own thread records events, and only the writer thread reads them, so head and tail
+    are the only shared state.
+*/
+class ActionLog {
+public:
+    static const size_t CAPACITY = 4096;
+
+private:
+    static const size_t MASK = CAPACITY - 1;
+    static_assert((CAPACITY & MASK) == 0, "ring buffer capacity must be a power of two");
+
+    array<LogEvent, CAPACITY> m_ring;
+    atomic<uint64_t> m_head; // next slot to write
+    atomic<uint64_t> m_tail; // oldest event still in the buffer
+    atomic<uint64_t> m_dropped;
+
+    //The table thread's own copies, so recording only looks at the shared tail when the ring seems full.
+    uint64_t m_localHead;
+    uint64_t m_cachedTail;
+
+    //Seat number -> player name, only touched when someone joins and when formatting.
+    mutable mutex m_namesMutex;
+    unordered_map<int, string> m_names;
+
+    thread m_writer;
+    atomic<bool> m_writerActive;
+    atomic<bool> m_stopWriter;
+    string m_path;
+
+    void writerLoop(ofstream out){
+        while (true){
+            bool stopping = m_stopWriter.load(memory_order_acquire);
+            uint64_t head = m_head.load(memory_order_acquire);
+            uint64_t tail = m_tail.load(memory_order_relaxed);
+
+            for (; tail != head; tail++){
+                out << format(m_ring[tail & MASK]) << '\n';
+            }
+            bool drainedAny = (tail != m_tail.load(memory_order_relaxed));
+            m_tail.store(tail, memory_order_release);
+
+            if (stopping){
+                break;
+            }
+            //Only nap when there was nothing to do, a busy table keeps the writer going flat out.
+            if (!drainedAny){
+                out.flush();
+                this_thread::sleep_for(chrono::milliseconds(5));
+            }
+        }
+        uint64_t dropped = m_dropped.load();
+        if (dropped > 0){
+            out << "(" << dropped << " events dropped, the writer fell behind)\n";
+        }
+    }
+
+public:
+    ActionLog() : m_head(0), m_tail(0), m_dropped(0), m_localHead(0), m_cachedTail(0), m_writerActive(false), m_stopWriter(false){}
+    ~ActionLog(){
+        stopWriter();
+    }
+    ActionLog(const ActionLog&) = delete;
+    ActionLog& operator=(const ActionLog&) = delete;
+
+    //Hot path: one struct copy into the ring, no strings and no allocation.
+    void record(LogEventType type, int seat, uint64_t round, int amount = 0, Card card = Card()){
+        uint64_t head = m_localHead;
+
+        if (head - m_cachedTail == CAPACITY){
+            m_cachedTail = m_tail.load(memory_order_acquire);
+            if (head - m_cachedTail == CAPACITY){
+                if (m_writerActive.load(memory_order_relaxed)){
+                    m_dropped.fetch_add(1, memory_order_relaxed);
+                    return;
+                }
+                m_cachedTail++;
+                m_tail.store(m_cachedTail, memory_order_release);
+            }
+        }
+
+        LogEvent& slot = m_ring[head & MASK];
+        slot.round = round;
+        slot.seat = seat;
+        slot.amount = amount;
+        slot.type = type;
+        slot.card = card;
+        m_localHead = head + 1;
+        m_head.store(m_localHead, memory_order_release);
+    }
+
+    void registerName(int seat, const string& name){
+        lock_guard<mutex> lock(m_namesMutex);
+        m_names[seat] = name;
+    }
+
+    string nameFor(int seat) const{
+        if (seat == DEALER_SEAT){
+            return "Dealer";
+        }
+        lock_guard<mutex> lock(m_namesMutex);
+        auto found = m_names.find(seat);
+        return found != m_names.end() ? found->second : "Seat " + to_string(seat + 1);
+    }
+
+    string format(const LogEvent& e) const{
+        string who = nameFor(e.seat);
+        string card = string(e.card.getRank()) + " of " + e.card.getSuit();
+        string amount = to_string(e.amount);
+        string line = "[round " + to_string(e.round) + "] ";
+
+        switch (e.type){
+            case LogEventType::JOINED:        return line + who + " joined the game.";
+            case LogEventType::FORFEITED:     return line + who + " has forfeited.";
+            case LogEventType::OUT_OF_MONEY:  return line + who + " left the game (out of money)";
+            case LogEventType::SHUFFLED:      return line + "Dealer shuffles the shoe.";
+            case LogEventType::BET:           return line + who + " bet $" + amount;
+            case LogEventType::DEALT:         return line + who + " is dealt " + card;
+            case LogEventType::HIT:           return line + who + " hits and receives " + card;
+            case LogEventType::DOUBLED:       return line + who + " doubled down to $" + amount;
+            case LogEventType::BLACKJACK:     return line + who + " got a blackjack!";
+            case LogEventType::BUSTED:        return line + who + " busted with " + amount;
+            case LogEventType::STOOD:         return line + who + " stands with " + amount;
+            case LogEventType::ALL_BUSTED:    return line + "All players busted, dealer wins";
+            case LogEventType::DEALER_HIT:    return line + "Dealer receives " + card;
+            case LogEventType::DEALER_BUSTED: return line + "Dealer busted with " + amount;
+            case LogEventType::DEALER_STOOD:  return line + "Dealer stands with " + amount;
+            case LogEventType::WON:           return line + who + " won $" + amount;
+            case LogEventType::LOST:          return line + who + " lost $" + amount;
+            case LogEventType::PUSHED:        return line + who + " pushed, $" + amount + " returned";
+            case LogEventType::SPLIT:         return line + who + " splits, now playing " + amount + " hands";
+            case LogEventType::SURRENDERED:   return line + who + " surrenders half of $" + amount;
+            case LogEventType::INSURED:       return line + who + " takes insurance for $" + amount;
+            case LogEventType::INSURANCE_PAID: return line + who + "'s insurance pays $" + amount;
+            case LogEventType::INSURANCE_LOST: return line + who + " loses $" + amount + " of insurance";
+        }
+        return line + "?";
+    }
+
+    /*
+        starts the background writer, appending to path. returns false if the file can't be opened
+        or a writer is already running.
+    */
+    bool startWriter(const string& path){
+        if (m_writerActive){
+            return false;
+        }
+        ofstream out(path, ios::app);
+        if (!out){
+            return false;
+        }
+        m_path = path;
+        m_stopWriter = false;
+        m_writerActive = true;
+        m_writer = thread(&ActionLog::writerLoop, this, move(out));
+        return true;
+    }
+    //Flushes whatever is left and joins the writer thread.
+    void stopWriter(){
+        if (!m_writerActive){
+            return;
+        }
+        m_stopWriter.store(true, memory_order_release);
+        m_writer.join();
+        m_writerActive = false;
+    }
+    bool hasWriter() const{
+        return m_writerActive;
+    }
+    const string& getPath() const{
+        return m_path;
+    }
+
+    size_t size() const{
+        return static_cast<size_t>(m_head.load() - m_tail.load());
+    }
+    uint64_t dropped() const{
+        return m_dropped.load();
+    }
+
+    //Walks the events still in the buffer, oldest first. only meaningful with no writer running.
+    template <class Visitor>
+    void forEach(Visitor visit) const{
+        uint64_t head = m_head.load(memory_order_acquire);
+        for (uint64_t i = m_tail.load(memory_order_acquire); i != head; i++){
+            visit(m_ring[i & MASK]);
+        }
+    }
+    /*
+        walks the events recorded since cursor and moves cursor up to date, for readers on the table's own
+        thread that want every new event once (the server streaming them out). if the ring has lapped the
+        cursor, the overwritten events are simply skipped.
+    */
+    template <class Visitor>
+    void forEachSince(uint64_t& cursor, Visitor visit) const{
+        uint64_t head = m_head.load(memory_order_acquire);
+        uint64_t tail = m_tail.load(memory_order_acquire);
+        for (uint64_t i = max(cursor, tail); i != head; i++){
+            visit(m_ring[i & MASK]);
+        }
+        cursor = head;
+    }
+};
+
+
+/*
+    one saved profile. fixed 64 bytes, so a record sits inside a single cache line and never
+    straddles a page of the mapped file.
+*/
+struct ProfileRecord {
+    static const size_t MAXNAME = 31;
+
+    char name[MAXNAME + 1]; // empty name = unused slot
+    int64_t money;
+    int64_t highScore;
+    uint32_t wins;
+    uint32_t losses;
+    uint32_t rounds;
+    uint32_t reserved;
+};
+static_assert(sizeof(ProfileRecord) == 64, "profile records are meant to be exactly 64 bytes");
+
+/*
+    ProfileStore keeps every player profile in one memory mapped file, laid out as an open addressing
+    hash table of ProfileRecords behind a small header. opening it is just an mmap, nothing gets read
+    or parsed up front, so startup costs the same with 10 profiles or 100k.
+
+    updates rewrite a record in place, straight into the mapped page, so they aren't atomic: a crash
+    or power cut partway through writing the page back can leave a record torn, half old and half new.
+    the store doesn't detect that. flush() asks for the dirty pages to be written without waiting on them,
+    which only narrows the window.
+
+    when the table gets too full it's rebuilt at double the size in a temp file and renamed over the
+    old one, so the file on disk is always either the old table or the new one. slot numbers change when
+    that happens, so anyone holding one should find() again after insert().
+*/
+class ProfileStore {
+private:
+    struct Header {
+        char magic[8];
+        uint64_t capacity; // slots, always a power of two
+        uint64_t count;
+        char reserved[40];
+    };
+    static_assert(sizeof(Header) == 64, "header keeps the records 64 byte aligned");
+
+    static const uint64_t INITIALCAPACITY = 1 << 12;
+
+    string m_path;
+    int m_fd;
+    void* m_map;
+    size_t m_mapSize;
+    Header* m_header;
+    ProfileRecord* m_slots;
+
+    static uint64_t hashName(const char* name){
+        uint64_t h = 1469598103934665603ULL;
+        for (; *name; name++){
+            h = (h ^ static_cast<unsigned char>(*name)) * 1099511628211ULL;
+        }
+        return h;
+    }
+    static size_t fileSize(uint64_t capacity){
+        return sizeof(Header) + capacity * sizeof(ProfileRecord);
+    }
+
+    //Linear probe from the name's home slot, stopping at the name or the first empty slot.
+    uint64_t probe(const char* name) const{
+        uint64_t mask = m_header->capacity - 1;
+        uint64_t slot = hashName(name) & mask;
+        while (m_slots[slot].name[0] != '\0' && strcmp(m_slots[slot].name, name) != 0){
+            slot = (slot + 1) & mask;
+        }
+        return slot;
+    }
+
+    bool mapFile(const string& path, uint64_t capacityIfNew){
+#ifdef BLKJCK_HAVE_MMAP
+        int fd = ::open(path.c_str(), O_RDWR | O_CREAT, 0644);
+        if (fd < 0){
+            return false;
+        }
+        struct stat info;
+        if (fstat(fd, &info) != 0){
+            ::close(fd);
+            return false;
+        }
+
+        bool fresh = (info.st_size == 0);
+        size_t size = fresh ? fileSize(capacityIfNew) : static_cast<size_t>(info.st_size);
+        if (fresh && ftruncate(fd, static_cast<off_t>(size)) != 0){
+            ::close(fd);
+            return false;
+        }
+
+        void* map = mmap(nullptr, size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+        if (map == MAP_FAILED){
+            ::close(fd);
+            return false;
+        }
+
+        Header* header = static_cast<Header*>(map);
+        if (fresh){
+            memcpy(header->magic, "BJPROF01", 8);
+            header->capacity = capacityIfNew;
+            header->count = 0;
+        }
+        //Probing needs a power of two capacity and at least one empty slot to stop at, anything else is damaged.
+        else if (memcmp(header->magic, "BJPROF01", 8) != 0 || header->capacity == 0
+                 || (header->capacity & (header->capacity - 1)) != 0 || header->count >= header->capacity
+                 || header->capacity > (SIZE_MAX - sizeof(Header)) / sizeof(ProfileRecord)
+                 || fileSize(header->capacity) != size){
+            munmap(map, size);
+            ::close(fd);
+            return false;
+        }
+
+        m_fd = fd;
+        m_map = map;
+        m_mapSize = size;
+        m_header = header;
+        m_slots = reinterpret_cast<ProfileRecord*>(static_cast<char*>(map) + sizeof(Header));
+        return true;
+#else
+        return false;
+#endif
+    }
+
+    //Rehashes everything into a table twice the size, then swaps the files.
+    bool grow(){
+        string tmpPath = m_path + ".tmp";
+        ProfileStore bigger;
+        ::remove(tmpPath.c_str());
+        if (!bigger.mapFile(tmpPath, m_header->capacity * 2)){
+            return false;
+        }
+        bigger.m_path = tmpPath;
+
+        for (uint64_t i = 0; i < m_header->capacity; i++){
+            if (m_slots[i].name[0] != '\0'){
+                bigger.m_slots[bigger.probe(m_slots[i].name)] = m_slots[i];
+                bigger.m_header->count++;
+            }
+        }
+        bigger.sync(true);
+        bigger.close();
+
+        if (rename(tmpPath.c_str(), m_path.c_str()) != 0){
+            return false;
+        }
+        string path = m_path;
+        close();
+        return open(path);
+    }
+
+    void sync(bool wait){
+#ifdef BLKJCK_HAVE_MMAP
+        if (m_map != nullptr){
+            msync(m_map, m_mapSize, wait ? MS_SYNC : MS_ASYNC);
+        }
+#endif
+    }
+
+public:
+    ProfileStore() : m_fd(-1), m_map(nullptr), m_mapSize(0), m_header(nullptr), m_slots(nullptr){}
+    ~ProfileStore(){
+        close();
+    }
+    ProfileStore(const ProfileStore&) = delete;
+    ProfileStore& operator=(const ProfileStore&) = delete;
+
+    //Opens (or creates) the store at path. false if the file can't be mapped or isn't a profile store.
+    bool open(const string& path){
+        close();
+        if (!mapFile(path, INITIALCAPACITY)){
+            return false;
+        }
+        m_path = path;
+        return true;
+    }
+    void close(){
+#ifdef BLKJCK_HAVE_MMAP
+        if (m_map != nullptr){
+            sync(false);
+            munmap(m_map, m_mapSize);
+            ::close(m_fd);
+        }
+#endif
+        m_fd = -1;
+        m_map = nullptr;
+        m_mapSize = 0;
+        m_header = nullptr;
+        m_slots = nullptr;
+    }
+    bool isOpen() const{
+        return m_map != nullptr;
+    }
+    size_t size() const{
+        return isOpen() ? static_cast<size_t>(m_header->count) : 0;
+    }
+
+    //Slot holding name, or -1 if there's no such profile.
+    long long find(const string& name) const{
+        if (!isOpen() || name.empty() || name.size() > ProfileRecord::MAXNAME){
+            return -1;
+        }
+        uint64_t slot = probe(name.c_str());
+        return m_slots[slot].name[0] != '\0' ? static_cast<long long>(slot) : -1;
+    }
+
+    /*
+        adds a new profile with the given starting money and returns its slot, or -1 if the name is
+        taken, empty, longer than ProfileRecord::MAXNAME, or the store isn't open.
+    */
+    long long insert(const string& name, int money){
+        if (!isOpen() || name.empty() || name.size() > ProfileRecord::MAXNAME || find(name) >= 0){
+            return -1;
+        }
+        //Keep the table under 70% full so probes stay short.
+        if ((m_header->count + 1) * 10 > m_header->capacity * 7 && !grow()){
+            return -1;
+        }
+
+        uint64_t slot = probe(name.c_str());
+        ProfileRecord record{};
+        memcpy(record.name, name.c_str(), name.size());
+        record.money = money;
+        record.highScore = money;
+        m_slots[slot] = record;
+        m_header->count++;
+        return static_cast<long long>(slot);
+    }
+
+    const ProfileRecord& at(long long slot) const{
+        return m_slots[slot];
+    }
+
+    //Rewrites one profile's money and record after a round.
+    void update(long long slot, int money, int wins, int losses){
+        ProfileRecord record = m_slots[slot];
+        record.money = money;
+        record.highScore = max<int64_t>(record.highScore, money);
+        record.wins = static_cast<uint32_t>(wins);
+        record.losses = static_cast<uint32_t>(losses);
+        record.rounds++;
+        m_slots[slot] = record;
+    }
+
+    //Starts writing dirty pages back to disk without waiting for them.
+    void flush(){
+        sync(false);
+    }
+};
+
+
+/*
+    opt-in instrumentation for where a round's time goes. build with BLKJCK_INSTRUMENT defined (the
+    cmake option of the same name does it) and every table keeps a latency histogram per GameState
+    phase plus a tally of everything it logged, reported when the program shuts down. without it the
+    BLKJCK_ macros below expand to nothing and Game doesn't even carry the member, so simulation builds
+    pay nothing for it.
+
+    a phase is timed for as long as the table is working in it. a table waiting on a person returns
+    out of advance(), so a betting phase that took three prompts shows up as three short samples,
+    not however long the people took to type.
+*/
+#ifdef BLKJCK_INSTRUMENT
+class LatencyHistogram {
+private:
+    //Bucket b holds samples under 2^b nanoseconds (and at least 2^(b-1)), the last one catches the rest.
+    static const int BUCKETS = 40;
+
+    array<uint64_t, BUCKETS> m_buckets;
+    uint64_t m_samples;
+    uint64_t m_totalNs;
+    uint64_t m_maxNs;
+
+    static int bucketOf(uint64_t ns){
+        int b = 0;
+        while (ns && b < BUCKETS - 1){
+            ns >>= 1;
+            b++;
+        }
+        return b;
+    }
+
+public:
+    LatencyHistogram() : m_samples(0), m_totalNs(0), m_maxNs(0){
+        m_buckets.fill(0);
+    }
+
+    void record(uint64_t ns){
+        m_buckets[bucketOf(ns)]++;
+        m_samples++;
+        m_totalNs += ns;
+        m_maxNs = max(m_maxNs, ns);
+    }
+    void merge(const LatencyHistogram& other){
+        for (int b = 0; b < BUCKETS; b++){
+            m_buckets[b] += other.m_buckets[b];
+        }
+        m_samples += other.m_samples;
+        m_totalNs += other.m_totalNs;
+        m_maxNs = max(m_maxNs, other.m_maxNs);
+    }
+
+    uint64_t samples() const{
+        return m_samples;
+    }
+    uint64_t totalNs() const{
+        return m_totalNs;
+    }
+    uint64_t maxNs() const{
+        return m_maxNs;
+    }
+    double meanNs() const{
+        return m_samples ? static_cast<double>(m_totalNs) / m_samples : 0.0;
+    }
+    //Upper edge of the bucket the q'th quantile lands in, so it's never an underestimate by more than 2x.
+    uint64_t quantileNs(double q) const{
+        if (m_samples == 0){
+            return 0;
+        }
+        uint64_t rank = static_cast<uint64_t>(q * (m_samples - 1)) + 1;
+        uint64_t seen = 0;
+        for (int b = 0; b < BUCKETS; b++){
+            seen += m_buckets[b];
+            if (seen >= rank){
+                return min(b ? uint64_t(1) << b : uint64_t(0), m_maxNs);
+            }
+        }
+        return m_maxNs;
+    }
+};
+
+class TableMetrics {
+public:
+    //One per Game::GameState, in the same order.
+    static const int PHASES = 7;
+    static constexpr const char* PHASE_NAMES[PHASES] = {"betting", "dealing", "insurance", "player_turn", "dealer_turn", "payout", "cleanup"};
+    static const int EVENT_TYPES = static_cast<int>(LogEventType::INSURANCE_LOST) + 1;
+
+    //Times whatever phase it was made in until it goes out of scope.
+    class PhaseTimer {
+    private:
+        TableMetrics& m_metrics;
+        int m_phase;
+        chrono::steady_clock::time_point m_start;
+
+    public:
+        PhaseTimer(TableMetrics& metrics, int phase) : m_metrics(metrics), m_phase(phase), m_start(chrono::steady_clock::now()){}
+        PhaseTimer(const PhaseTimer&) = delete;
+        PhaseTimer& operator=(const PhaseTimer&) = delete;
+        ~PhaseTimer(){
+            auto ns = chrono::duration_cast<chrono::nanoseconds>(chrono::steady_clock::now() - m_start).count();
+            m_metrics.m_phases[m_phase].record(static_cast<uint64_t>(ns));
+        }
+    };
+
+private:
+    array<LatencyHistogram, PHASES> m_phases;
+    array<uint64_t, EVENT_TYPES> m_events;
+    uint64_t m_rounds;
+
+    uint64_t events(LogEventType type) const{
+        return m_events[static_cast<int>(type)];
+    }
+
+public:
+    TableMetrics() : m_rounds(0){
+        m_events.fill(0);
+    }
+
+    void countEvent(LogEventType type){
+        m_events[static_cast<int>(type)]++;
+    }
+    void countRound(){
+        m_rounds++;
+    }
+    void merge(const TableMetrics& other){
+        for (int p = 0; p < PHASES; p++){
+            m_phases[p].merge(other.m_phases[p]);
+        }
+        for (int e = 0; e < EVENT_TYPES; e++){
+            m_events[e] += other.m_events[e];
+        }
+        m_rounds += other.m_rounds;
+    }
+
+    uint64_t rounds() const{
+        return m_rounds;
+    }
+    uint64_t cardsDealt() const{
+        return events(LogEventType::DEALT) + events(LogEventType::HIT) + events(LogEventType::DEALER_HIT);
+    }
+    uint64_t reshuffles() const{
+        return events(LogEventType::SHUFFLED);
+    }
+    uint64_t playerBusts() const{
+        return events(LogEventType::BUSTED);
+    }
+    uint64_t dealerBusts() const{
+        return events(LogEventType::DEALER_BUSTED);
+    }
+    const LatencyHistogram& phase(int p) const{
+        return m_phases[p];
+    }
+
+    //Named counters, in the order both reports list them.
+    vector<pair<const char*, uint64_t>> counters() const{
+        return {
+            {"rounds", m_rounds},
+            {"cards_dealt", cardsDealt()},
+            {"reshuffles", reshuffles()},
+            {"player_busts", playerBusts()},
+            {"dealer_busts", dealerBusts()},
+            {"blackjacks", events(LogEventType::BLACKJACK)},
+            {"doubles", events(LogEventType::DOUBLED)},
+            {"splits", events(LogEventType::SPLIT)},
+            {"surrenders", events(LogEventType::SURRENDERED)},
+            {"insurance_taken", events(LogEventType::INSURED)}
+        };
+    }
+
+    void writeText(ostream& out) const{
+        out << "\n===== TABLE METRICS =====\n";
+        for (const auto& counter : counters()){
+            out << setw(16) << left << counter.first << right << counter.second << endl;
+        }
+        out << setw(14) << left << "\nPhase"
+            << setw(12) << right << "Samples"
+            << setw(12) << "Mean ns"
+            << setw(12) << "p50 ns"
+            << setw(12) << "p90 ns"
+            << setw(12) << "p99 ns"
+            << setw(12) << "Max ns"
+            << setw(12) << "Total ms" << endl;
+        for (int p = 0; p < PHASES; p++){
+            const LatencyHistogram& h = m_phases[p];
+            out << setw(13) << left << PHASE_NAMES[p]
+                << setw(12) << right << h.samples()
+                << setw(12) << fixed << setprecision(0) << h.meanNs()
+                << setw(12) << h.quantileNs(0.50)
+                << setw(12) << h.quantileNs(0.90)
+                << setw(12) << h.quantileNs(0.99)
+                << setw(12) << h.maxNs()
+                << setw(12) << setprecision(3) << h.totalNs() / 1e6 << endl;
+        }
+    }
+    void writeJson(ostream& out) const{
+        out << "{\n  \"counters\": {";
+        vector<pair<const char*, uint64_t>> named = counters();
+        for (size_t i = 0; i < named.size(); i++){
+            out << (i ? ", " : "") << "\"" << named[i].first << "\": " << named[i].second;
+        }
+        out << "},\n  \"phases\": {\n";
+        for (int p = 0; p < PHASES; p++){
+            const LatencyHistogram& h = m_phases[p];
+            out << "    \"" << PHASE_NAMES[p] << "\": {\"samples\": " << h.samples()
+                << ", \"mean_ns\": " << fixed << setprecision(1) << h.meanNs()
+                << ", \"p50_ns\": " << h.quantileNs(0.50)
+                << ", \"p90_ns\": " << h.quantileNs(0.90)
+                << ", \"p99_ns\": " << h.quantileNs(0.99)
+                << ", \"max_ns\": " << h.maxNs()
+                << ", \"total_ns\": " << h.totalNs() << "}" << (p + 1 < PHASES ? "," : "") << "\n";
+        }
+        out << "  }\n}\n";
+    }
+    //Text to the terminal with no path, otherwise to the file, as JSON when it ends in .json.
+    bool write(const string& path) const{
+        if (path.empty()){
+            writeText(cout);
+            return true;
+        }
+        ofstream out(path);
+        if (!out){
+            return false;
+        }
+        bool json = path.size() >= 5 && path.compare(path.size() - 5, 5, ".json") == 0;
+        if (json){
+            writeJson(out);
+        }
+        else{
+            writeText(out);
+        }
+        return static_cast<bool>(out);
+    }
+};
+
+#define BLKJCK_TIME_PHASE(metrics, phase) TableMetrics::PhaseTimer phaseTimer_(metrics, static_cast<int>(phase))
+#define BLKJCK_COUNT_EVENT(metrics, type) (metrics).countEvent(type)
+#define BLKJCK_COUNT_ROUND(metrics) (metrics).countRound()
+#else
+#define BLKJCK_TIME_PHASE(metrics, phase) ((void)0)
+#define BLKJCK_COUNT_EVENT(metrics, type) ((void)0)
+#define BLKJCK_COUNT_ROUND(metrics) ((void)0)
+#endif
+
+
+/*
+    TableArena is where a table's own containers get their memory. a pool of reusable blocks sits on top
+    of chunks carved from a buffer inside the arena (and from the heap only once that runs out), with no
+    locking, since a table only ever runs on one thread at a time. lots of tables in one process then
+    stop fighting over the global allocator, and the blocks a player's seat frees up get reused by the next.
+*/
+class TableArena {
+private:
+    static const size_t INLINEBYTES = 16 * 1024;
+
+    alignas(max_align_t) unsigned char m_buffer[INLINEBYTES];
+    pmr::monotonic_buffer_resource m_chunks;
+    pmr::unsynchronized_pool_resource m_pool;
+
+public:
+    TableArena() : m_chunks(m_buffer, sizeof(m_buffer)), m_pool(&m_chunks){}
+    TableArena(const TableArena&) = delete;
+    TableArena& operator=(const TableArena&) = delete;
+
+    pmr::memory_resource* resource(){
+        return &m_pool;
+    }
+};
+
+
+/*
+    a replay is everything a table can't work out for itself: its seed, its shoe, who sat down, and
+    every bet and decision that came from a person. bots and the shoe are deterministic from there, so
+    playing the events back into a fresh Game reproduces the session exactly, with no prompts and at
+    simulation speed.
+
+    the file is a short magic string followed by events, each a type byte and its fields as LEB128
+    varints (signed ones zigzagged). rounds nobody had to answer anything in are written as a single
+    run length, so a billion bot rounds cost a few bytes. END holds the money everyone finished with,
+    which the replay checks itself against.
+*/
+enum class ReplayEventType : uint8_t {
+    SEED, SHOE, JOIN, LEAVE, SHUFFLE, ROUNDS, BET, INSURANCE, ACTION, FORFEIT, END, RULES, COUNT, POLICY
+};
+
+const char REPLAYMAGIC[8] = {'B', 'J', 'R', 'E', 'P', 'L', 'A', 'Y'};
+
+class ReplayRecorder {
+private:
+    ofstream m_out;
+    uint64_t m_pendingRounds; // rounds begun since the last event, written out lazily as one ROUNDS
+
+    void putVarint(uint64_t value){
+        while (value >= 0x80){
+            m_out.put(static_cast<char>((value & 0x7F) | 0x80));
+            value >>= 7;
+        }
+        m_out.put(static_cast<char>(value));
+    }
+    void putSigned(int64_t value){
+        putVarint((static_cast<uint64_t>(value) << 1) ^ static_cast<uint64_t>(value >> 63));
+    }
+    void putString(const string& text){
+        putVarint(text.size());
+        m_out.write(text.data(), static_cast<streamsize>(text.size()));
+    }
+    void begin(ReplayEventType type){
+        if (m_pendingRounds > 0){
+            m_out.put(static_cast<char>(ReplayEventType::ROUNDS));
+            putVarint(m_pendingRounds);
+            m_pendingRounds = 0;
+        }
+        m_out.put(static_cast<char>(type));
+    }
+    //Events are rare next to rounds, so each one goes straight out and a crashed session still replays up to it.
+    void flush(){
+        m_out.flush();
+    }
+
+public:
+    ReplayRecorder() : m_pendingRounds(0){}
+
+    bool open(const string& path){
+        m_out.open(path, ios::binary | ios::trunc);
+        if (!m_out){
+            return false;
+        }
+        m_out.write(REPLAYMAGIC, sizeof(REPLAYMAGIC));
+        m_pendingRounds = 0;
+        return true;
+    }
+    bool isOpen() const{
+        return m_out.is_open();
+    }
+
+    void seed(uint64_t seedValue, uint32_t stream){
+        begin(ReplayEventType::SEED);
+        putVarint(seedValue);
+        putVarint(stream);
+        flush();
+    }
+    void shoe(int numDecks, double penetration){
+        begin(ReplayEventType::SHOE);
+        uint64_t bits;
+        memcpy(&bits, &penetration, sizeof(bits));
+        putVarint(static_cast<uint64_t>(numDecks));
+        putVarint(bits);
+        flush();
+    }
+    //Everything but the deck count, SHOE has that.
+    void rules(const TableRules& rules){
+        begin(ReplayEventType::RULES);
+        putVarint(rules.hitSoft17);
+        putVarint(static_cast<uint64_t>(rules.blackjackPays));
+        putVarint(static_cast<uint64_t>(rules.doubleOn));
+        putVarint(rules.doubleAfterSplit);
+        putVarint(static_cast<uint64_t>(rules.maxHands));
+        putVarint(rules.lateSurrender);
+        flush();
+    }
+    //flatBet is 0 for people, their bets come in as BET events.
+    void join(int seat, const string& name, int money, int flatBet){
+        begin(ReplayEventType::JOIN);
+        putVarint(static_cast<uint64_t>(seat));
+        putString(name);
+        putSigned(money);
+        putSigned(flatBet);
+        flush();
+    }
+    void countSystem(const CountSystem& system){
+        begin(ReplayEventType::COUNT);
+        putString(system.name);
+        flush();
+    }
+    /*
+        a bot's bet policy, right after its JOIN. lastBet and lastNet are how its last round went, so a
+        progression like martingale carries on where it was when the recording started mid-session.
+    */
+    void policy(int seat, const BetPolicy& policy, int lastBet, int lastNet){
+        begin(ReplayEventType::POLICY);
+        putVarint(static_cast<uint64_t>(seat));
+        putString(policy.spec());
+        putVarint(static_cast<uint64_t>(lastBet));
+        putSigned(lastNet);
+        flush();
+    }
+    void leave(int seat){
+        begin(ReplayEventType::LEAVE);
+        putVarint(static_cast<uint64_t>(seat));
+        flush();
+    }
+    void shuffle(){
+        begin(ReplayEventType::SHUFFLE);
+        flush();
+    }
+    void round(){
+        m_pendingRounds++;
+    }
+    void bet(int seat, int amount){
+        begin(ReplayEventType::BET);
+        putVarint(static_cast<uint64_t>(seat));
+        putSigned(amount);
+        flush();
+    }
+    void insurance(int seat, bool take){
+        begin(ReplayEventType::INSURANCE);
+        putVarint(static_cast<uint64_t>(seat));
+        putVarint(take);
+        flush();
+    }
+    void action(int seat, Action choice){
+        begin(ReplayEventType::ACTION);
+        putVarint(static_cast<uint64_t>(seat));
+        putVarint(static_cast<uint64_t>(choice));
+        flush();
+    }
+    void forfeit(int seat){
+        begin(ReplayEventType::FORFEIT);
+        putVarint(static_cast<uint64_t>(seat));
+        flush();
+    }
+    //Closes the file off with where everyone ended up.
+    void finish(const pmr::deque<unique_ptr<Player>>& players){
+        begin(ReplayEventType::END);
+        putVarint(players.size());
+        for (const auto& p : players){
+            putVarint(static_cast<uint64_t>(p->getSeat()));
+            putSigned(p->getMoney());
+        }
+        m_out.close();
+    }
+};
+
+
+/*
+    the hand history is every settled hand written out for offline analysis, a row per hand (split hands
+    get one each), stored column by column so a scan only touches the columns it reads.
+
+    the file is a 64 byte HistoryFileHeader followed by chunks of up to chunkRows rows. each chunk is a
+    32 byte HistoryChunkHeader and then its columns one after the other, each padded to 8 bytes, in the
+    order HistoryLayout lists them. the cards of a hand are variable length, so the player's and the
+    dealer's cards sit in two byte columns with an end offset per row, one byte a card, rank | suit << 4
+    like Card packs them, in the order they were dealt (so the dealer's hole card comes before the upcard).
+    decisions are the flags plus the cards: every card after the first two was a hit, or the one double
+    down card when the hand was doubled.
+
+    the file header is written again when the writer closes, with the table's seed and rules as they
+    were by then and the rows and chunks filled in. a reader that finds those 0 just walks the chunks
+    that made it to disk.
+*/
+enum HistoryFlag : uint8_t {
+    HISTORY_DOUBLED = 1, HISTORY_SPLIT = 2, HISTORY_SURRENDERED = 4, HISTORY_INSURED = 8,
+    HISTORY_BLACKJACK = 16, HISTORY_BUSTED = 32, HISTORY_DEALER_BLACKJACK = 64, HISTORY_DEALER_BUSTED = 128
+};
+
+const char HISTORYMAGIC[8] = {'B', 'J', 'H', 'I', 'S', 'T', '0', '1'};
+const char HISTORYCHUNKMAGIC[4] = {'C', 'H', 'N', 'K'};
+
+struct HistoryFileHeader {
+    char magic[8];
+    uint64_t seed; // the table's seed and stream, as of the last time it was seeded
+    uint32_t stream;
+    uint32_t numDecks;
+    uint32_t chunkRows;
+    uint8_t rules[8]; // hitSoft17, blackjackPays, doubleOn, doubleAfterSplit, maxHands, lateSurrender
+    uint32_t reserved0;
+    uint64_t rows;
+    uint64_t chunks;
+    char reserved[8];
+};
+static_assert(sizeof(HistoryFileHeader) == 64, "the history header is meant to be exactly 64 bytes");
+
+struct HistoryChunkHeader {
+    char magic[4];
+    uint32_t rows;
+    uint32_t playerCardBytes;
+    uint32_t dealerCardBytes;
+    uint64_t bytes; // the whole chunk, this header included
+    uint64_t reserved;
+};
+static_assert(sizeof(HistoryChunkHeader) == 32, "chunk headers keep the columns 8 byte aligned");
+
+//Where each column of a chunk starts, from the start of the chunk. the writer and the reader both go by this.
+struct HistoryLayout {
+    enum Column {
+        ROUND, SEAT, BET, NET, INSURANCE, PLAYERCARDEND, DEALERCARDEND,
+        HAND, FLAGS, PLAYERTOTAL, DEALERTOTAL, UPCARD, OUTCOME, PLAYERCARDS, DEALERCARDS, COLUMNS
+    };
+    static constexpr uint64_t WIDTHS[PLAYERCARDS] = {8, 4, 4, 4, 4, 4, 4, 1, 1, 1, 1, 1, 1};
+
+    array<uint64_t, COLUMNS + 1> offset; // offset[COLUMNS] is the size of the whole chunk
+
+    static uint64_t padded(uint64_t bytes){
+        return (bytes + 7) & ~uint64_t(7);
+    }
+    HistoryLayout(uint64_t rows, uint64_t playerCardBytes, uint64_t dealerCardBytes){
+        offset[0] = sizeof(HistoryChunkHeader);
+        for (int c = 0; c < COLUMNS; c++){
+            uint64_t bytes = c < PLAYERCARDS ? rows * WIDTHS[c] : c == PLAYERCARDS ? playerCardBytes : dealerCardBytes;
+            offset[c + 1] = offset[c] + padded(bytes);
+        }
+    }
+    uint64_t bytes(int column) const{
+        return offset[column + 1] - offset[column];
+    }
+};
+
+/*
+    HandHistoryWriter fills one chunk's columns in memory while a background thread writes the last full
+    one out, so the table only waits on the disk if it gets a whole chunk ahead. every column is written
+    in one go, which keeps the file going out at close to sequential write speed. both chunks are sized
+    up front for the most cards a hand can hold, so adding a hand never allocates.
+*/
+class HandHistoryWriter {
+public:
+    static const uint32_t CHUNKROWS = 1 << 16;
+
+private:
+    struct Chunk {
+        vector<uint64_t> round;
+        vector<uint32_t> seat;
+        vector<int32_t> bet;
+        vector<int32_t> net;
+        vector<int32_t> insurance;
+        vector<uint32_t> playerCardEnd;
+        vector<uint32_t> dealerCardEnd;
+        vector<uint8_t> hand;
+        vector<uint8_t> flags;
+        vector<uint8_t> playerTotal;
+        vector<uint8_t> dealerTotal;
+        vector<uint8_t> upcard;
+        vector<int8_t> outcome;
+        vector<uint8_t> playerCards;
+        vector<uint8_t> dealerCards;
+        uint32_t rows = 0;
+        uint32_t playerCardBytes = 0;
+        uint32_t dealerCardBytes = 0;
+
+        void allocate(){
+            for (auto* column : {&seat, &playerCardEnd, &dealerCardEnd}){
+                column->assign(CHUNKROWS, 0);
+            }
+            for (auto* column : {&bet, &net, &insurance}){
+                column->assign(CHUNKROWS, 0);
+            }
+            for (auto* column : {&hand, &flags, &playerTotal, &dealerTotal, &upcard}){
+                column->assign(CHUNKROWS, 0);
+            }
+            round.assign(CHUNKROWS, 0);
+            outcome.assign(CHUNKROWS, 0);
+            playerCards.assign(static_cast<size_t>(CHUNKROWS) * MAXHANDCARDS, 0);
+            dealerCards.assign(static_cast<size_t>(CHUNKROWS) * MAXHANDCARDS, 0);
+        }
+    };
+
+    ofstream m_out;
+    string m_path;
+    HistoryFileHeader m_header;
+    array<Chunk, 2> m_chunks;
+    Chunk* m_filling;
+
+    thread m_writer;
+    mutex m_mutex;
+    condition_variable m_wake;
+    Chunk* m_pending; // handed to the writer and not written yet, nullptr when it's idle
+    bool m_stop;
+
+    static uint8_t packCard(const Card& card){
+        return static_cast<uint8_t>(card.rankIndex() | card.suitIndex() << 4);
+    }
+
+    template <class T>
+    void putColumn(const vector<T>& column, uint64_t bytes, uint64_t padded){
+        static const char ZEROS[8] = {};
+        m_out.write(reinterpret_cast<const char*>(column.data()), static_cast<streamsize>(bytes));
+        m_out.write(ZEROS, static_cast<streamsize>(padded - bytes));
+    }
+    void writeChunk(const Chunk& chunk){
+        HistoryLayout layout(chunk.rows, chunk.playerCardBytes, chunk.dealerCardBytes);
+        HistoryChunkHeader header = {};
+        memcpy(header.magic, HISTORYCHUNKMAGIC, sizeof(header.magic));
+        header.rows = chunk.rows;
+        header.playerCardBytes = chunk.playerCardBytes;
+        header.dealerCardBytes = chunk.dealerCardBytes;
+        header.bytes = layout.offset[HistoryLayout::COLUMNS];
+        m_out.write(reinterpret_cast<const char*>(&header), sizeof(header));
+
+        uint64_t rows = chunk.rows;
+        putColumn(chunk.round, rows * 8, layout.bytes(HistoryLayout::ROUND));
+        putColumn(chunk.seat, rows * 4, layout.bytes(HistoryLayout::SEAT));
+        putColumn(chunk.bet, rows * 4, layout.bytes(HistoryLayout::BET));
+        putColumn(chunk.net, rows * 4, layout.bytes(HistoryLayout::NET));
+        putColumn(chunk.insurance, rows * 4, layout.bytes(HistoryLayout::INSURANCE));
+        putColumn(chunk.playerCardEnd, rows * 4, layout.bytes(HistoryLayout::PLAYERCARDEND));
+        putColumn(chunk.dealerCardEnd, rows * 4, layout.bytes(HistoryLayout::DEALERCARDEND));
+        putColumn(chunk.hand, rows, layout.bytes(HistoryLayout::HAND));
+        putColumn(chunk.flags, rows, layout.bytes(HistoryLayout::FLAGS));
+        putColumn(chunk.playerTotal, rows, layout.bytes(HistoryLayout::PLAYERTOTAL));
+        putColumn(chunk.dealerTotal, rows, layout.bytes(HistoryLayout::DEALERTOTAL));
+        putColumn(chunk.upcard, rows, layout.bytes(HistoryLayout::UPCARD));
+        putColumn(chunk.outcome, rows, layout.bytes(HistoryLayout::OUTCOME));
+        putColumn(chunk.playerCards, chunk.playerCardBytes, layout.bytes(HistoryLayout::PLAYERCARDS));
+        putColumn(chunk.dealerCards, chunk.dealerCardBytes, layout.bytes(HistoryLayout::DEALERCARDS));
+
+        m_header.rows += chunk.rows;
+        m_header.chunks++;
+    }
+
+    void writerLoop(){
+        unique_lock<mutex> lock(m_mutex);
+        while (true){
+            m_wake.wait(lock, [this](){ return m_pending != nullptr || m_stop; });
+            if (m_pending == nullptr){
+                break;
+            }
+            Chunk* chunk = m_pending;
+            lock.unlock();
+            writeChunk(*chunk);
+            chunk->rows = chunk->playerCardBytes = chunk->dealerCardBytes = 0;
+            lock.lock();
+            m_pending = nullptr;
+            m_wake.notify_all();
+        }
+    }
+
+    //Hands the filled chunk to the writer, waiting for it to finish the one before, and starts on the other.
+    void submit(){
+        unique_lock<mutex> lock(m_mutex);
+        m_wake.wait(lock, [this](){ return m_pending == nullptr; });
+        m_pending = m_filling;
+        m_filling = (m_filling == &m_chunks[0]) ? &m_chunks[1] : &m_chunks[0];
+        m_wake.notify_all();
+    }
+
+public:
+    HandHistoryWriter() : m_header{}, m_filling(&m_chunks[0]), m_pending(nullptr), m_stop(false){}
+    ~HandHistoryWriter(){
+        close();
+    }
+    HandHistoryWriter(const HandHistoryWriter&) = delete;
+    HandHistoryWriter& operator=(const HandHistoryWriter&) = delete;
+
+    bool open(const string& path, uint64_t seedValue, uint32_t stream, const TableRules& rules){
+        close();
+        m_out.open(path, ios::binary | ios::trunc);
+        if (!m_out){
+            return false;
+        }
+        m_path = path;
+        m_header = HistoryFileHeader{};
+        memcpy(m_header.magic, HISTORYMAGIC, sizeof(m_header.magic));
+        m_header.chunkRows = CHUNKROWS;
+        seeded(seedValue, stream);
+        setRules(rules);
+        m_out.write(reinterpret_cast<const char*>(&m_header), sizeof(m_header));
+
+        for (Chunk& chunk : m_chunks){
+            chunk.allocate();
+        }
+        m_filling = &m_chunks[0];
+        m_pending = nullptr;
+        m_stop = false;
+        m_writer = thread(&HandHistoryWriter::writerLoop, this);
+        return true;
+    }
+    bool isOpen() const{
+        return m_out.is_open();
+    }
+    const string& path() const{
+        return m_path;
+    }
+    //The table was reseeded or changed its rules, the header picks it up when it's written at close.
+    void seeded(uint64_t seedValue, uint32_t stream){
+        m_header.seed = seedValue;
+        m_header.stream = stream;
+    }
+    void setRules(const TableRules& rules){
+        m_header.numDecks = static_cast<uint32_t>(rules.numDecks);
+        m_header.rules[0] = rules.hitSoft17;
+        m_header.rules[1] = static_cast<uint8_t>(rules.blackjackPays);
+        m_header.rules[2] = static_cast<uint8_t>(rules.doubleOn);
+        m_header.rules[3] = rules.doubleAfterSplit;
+        m_header.rules[4] = static_cast<uint8_t>(rules.maxHands);
+        m_header.rules[5] = rules.lateSurrender;
+    }
+
+    /*
+        one settled hand. insurance is what the seat's insurance made (0 without any), only on its first
+        hand. net is what the hand made on top of its bet coming back, like everywhere else.
+    */
+    void addHand(uint64_t round, int seat, int handIndex, uint8_t flags, const Hand& cards, int bet, int net,
+                 int insurance, HandOutcome outcome, const Hand& dealer, int upValue){
+        if (m_filling->rows == CHUNKROWS){
+            submit();
+        }
+        Chunk& chunk = *m_filling;
+        uint32_t row = chunk.rows++;
+        chunk.round[row] = round;
+        chunk.seat[row] = static_cast<uint32_t>(seat);
+        chunk.bet[row] = bet;
+        chunk.net[row] = net;
+        chunk.insurance[row] = insurance;
+        chunk.hand[row] = static_cast<uint8_t>(handIndex);
+        chunk.flags[row] = flags;
+        chunk.playerTotal[row] = static_cast<uint8_t>(cards.getTotal());
+        chunk.dealerTotal[row] = static_cast<uint8_t>(dealer.getTotal());
+        chunk.upcard[row] = static_cast<uint8_t>(upValue);
+        chunk.outcome[row] = static_cast<int8_t>(outcome);
+        for (const Card& card : cards){
+            chunk.playerCards[chunk.playerCardBytes++] = packCard(card);
+        }
+        for (const Card& card : dealer){
+            chunk.dealerCards[chunk.dealerCardBytes++] = packCard(card);
+        }
+        chunk.playerCardEnd[row] = chunk.playerCardBytes;
+        chunk.dealerCardEnd[row] = chunk.dealerCardBytes;
+    }
+
+    /*
+        writes out whatever's left, fills in the totals and closes the file. false if any of it didn't
+        make it to disk, a failed write leaves the stream failed so one check at the end catches them all.
+    */
+    bool close(){
+        if (!isOpen()){
+            return true;
+        }
+        if (m_filling->rows > 0){
+            submit();
+        }
+        {
+            lock_guard<mutex> lock(m_mutex);
+            m_stop = true;
+        }
+        m_wake.notify_all();
+        m_writer.join();
+
+        m_out.seekp(0);
+        m_out.write(reinterpret_cast<const char*>(&m_header), sizeof(m_header));
+        m_out.close();
+        bool written = !m_out.fail();
+        for (Chunk& chunk : m_chunks){
+            chunk = Chunk();
+        }
+        return written;
+    }
+};
+
+//One chunk's columns straight out of the mapped file, what HandHistoryReader hands its visitor.
+struct HistoryChunkView {
+    uint32_t rows;
+    const uint64_t* round;
+    const uint32_t* seat;
+    const int32_t* bet;
+    const int32_t* net;
+    const int32_t* insurance;
+    const uint32_t* playerCardEnd;
+    const uint32_t* dealerCardEnd;
+    const uint8_t* hand;
+    const uint8_t* flags;
+    const uint8_t* playerTotal;
+    const uint8_t* dealerTotal;
+    const uint8_t* upcard;
+    const int8_t* outcome;
+    const uint8_t* playerCards;
+    const uint8_t* dealerCards;
+
+    //Cards of row i, as [begin, end) into the card column.
+    uint32_t playerCardBegin(uint32_t i) const{
+        return i ? playerCardEnd[i - 1] : 0;
+    }
+    uint32_t dealerCardBegin(uint32_t i) const{
+        return i ? dealerCardEnd[i - 1] : 0;
+    }
+    //Whether a card byte is one packCard() could have written, worth asking before unpackCard() on a file you didn't write.
+    static bool isCard(uint8_t packed){
+        return (packed & 0x0F) < NUMRANKS && (packed >> 4) < NUMSUITS;
+    }
+    static Card unpackCard(uint8_t packed){
+        return Card(packed >> 4, packed & 0x0F);
+    }
+};
+
+/*
+    HandHistoryReader maps a hand history file read only and walks it chunk by chunk, nothing gets copied
+    or loaded up front. the kernel is told the file will be read front to back, so it reads ahead and
+    drops pages behind, and a file bigger than memory scans just as well.
+*/
+class HandHistoryReader {
+private:
+    const char* m_map;
+    size_t m_size;
+    HistoryFileHeader m_header;
+    string m_error;
+
+    bool fail(const string& why){
+        m_error = why;
+        return false;
+    }
+    template <class T>
+    static const T* column(const char* chunk, const HistoryLayout& layout, int c){
+        return reinterpret_cast<const T*>(chunk + layout.offset[c]);
+    }
+    /*
+        the framing check can't tell a damaged or foreign chunk whose sizes happen to add up, so the columns
+        a visitor indexes by get checked before it sees them: card end offsets that only go up and stay inside
+        the card columns, and upcards 2 to 11. the card bytes themselves are left to isCard(), checking them
+        here would fault in the card columns for every scan, even ones that never read a card.
+        no early exit in the loops, so the compiler can check a vector's worth of rows at a time.
+    */
+    static bool validRows(const HistoryChunkView& view, const HistoryChunkHeader& header){
+        if (view.rows == 0){
+            return true;
+        }
+        bool bad = false;
+        for (uint32_t i = 0; i < view.rows; i++){
+            bad |= static_cast<uint8_t>(view.upcard[i] - 2) > 9;
+        }
+        for (uint32_t i = 1; i < view.rows; i++){
+            bad |= view.playerCardEnd[i] < view.playerCardEnd[i - 1];
+            bad |= view.dealerCardEnd[i] < view.dealerCardEnd[i - 1];
+        }
+        uint32_t playerEnd = view.playerCardEnd[view.rows - 1];
+        uint32_t dealerEnd = view.dealerCardEnd[view.rows - 1];
+        return !bad && playerEnd <= header.playerCardBytes && dealerEnd <= header.dealerCardBytes;
+    }
+
+public:
+    HandHistoryReader() : m_map(nullptr), m_size(0), m_header{}{}
+    ~HandHistoryReader(){
+        close();
+    }
+    HandHistoryReader(const HandHistoryReader&) = delete;
+    HandHistoryReader& operator=(const HandHistoryReader&) = delete;
+
+    bool open(const string& path){
+        close();
+#ifdef BLKJCK_HAVE_MMAP
+        int fd = ::open(path.c_str(), O_RDONLY);
+        if (fd < 0){
+            return fail("can't open it");
+        }
+        struct stat info;
+        if (fstat(fd, &info) != 0 || static_cast<size_t>(info.st_size) < sizeof(HistoryFileHeader)){
+            ::close(fd);
+            return fail("too short to be a hand history");
+        }
+        size_t size = static_cast<size_t>(info.st_size);
+        void* map = mmap(nullptr, size, PROT_READ, MAP_PRIVATE, fd, 0);
+        ::close(fd);
+        if (map == MAP_FAILED){
+            return fail("can't map it");
+        }
+        madvise(map, size, MADV_SEQUENTIAL);
+        m_map = static_cast<const char*>(map);
+        m_size = size;
+
+        memcpy(&m_header, m_map, sizeof(m_header));
+        if (memcmp(m_header.magic, HISTORYMAGIC, sizeof(m_header.magic)) != 0){
+            close();
+            return fail("not a hand history");
+        }
+        //The rules get looked up by value when the header is printed, so they have to be ones that exist.
+        if (m_header.rules[1] > static_cast<uint8_t>(BlackjackPayout::EVEN_MONEY) || m_header.rules[2] > static_cast<uint8_t>(DoubleRule::TEN_OR_ELEVEN)
+            || m_header.rules[4] < 1 || m_header.rules[4] > MAXHANDS){
+            close();
+            return fail("damaged header");
+        }
+        return true;
+#else
+        return fail("this platform has no mmap");
+#endif
+    }
+    void close(){
+#ifdef BLKJCK_HAVE_MMAP
+        if (m_map != nullptr){
+            munmap(const_cast<char*>(m_map), m_size);
+        }
+#endif
+        m_map = nullptr;
+        m_size = 0;
+    }
+    const HistoryFileHeader& header() const{
+        return m_header;
+    }
+    size_t fileSize() const{
+        return m_size;
+    }
+    const string& error() const{
+        return m_error;
+    }
+
+    /*
+        calls visit(const HistoryChunkView&) for every chunk in the file, in order. false (with error()
+        saying why) if a chunk is damaged or cut short, every chunk before it has still been visited. a
+        visitor can index by a row's upcard and card offsets without checking them again.
+    */
+    template <class Visitor>
+    bool forEachChunk(Visitor visit){
+        size_t at = sizeof(HistoryFileHeader);
+        while (at < m_size){
+            if (m_size - at < sizeof(HistoryChunkHeader)){
+                return fail("truncated chunk header");
+            }
+            HistoryChunkHeader header;
+            memcpy(&header, m_map + at, sizeof(header));
+            if (memcmp(header.magic, HISTORYCHUNKMAGIC, sizeof(header.magic)) != 0){
+                return fail("bad chunk at byte " + to_string(at));
+            }
+            HistoryLayout layout(header.rows, header.playerCardBytes, header.dealerCardBytes);
+            if (layout.offset[HistoryLayout::COLUMNS] != header.bytes || header.bytes > m_size - at){
+                return fail("truncated chunk at byte " + to_string(at));
+            }
+
+            const char* chunk = m_map + at;
+            HistoryChunkView view;
+            view.rows = header.rows;
+            view.round = column<uint64_t>(chunk, layout, HistoryLayout::ROUND);
+            view.seat = column<uint32_t>(chunk, layout, HistoryLayout::SEAT);
+            view.bet = column<int32_t>(chunk, layout, HistoryLayout::BET);
+            view.net = column<int32_t>(chunk, layout, HistoryLayout::NET);
+            view.insurance = column<int32_t>(chunk, layout, HistoryLayout::INSURANCE);
+            view.playerCardEnd = column<uint32_t>(chunk, layout, HistoryLayout::PLAYERCARDEND);
+            view.dealerCardEnd = column<uint32_t>(chunk, layout, HistoryLayout::DEALERCARDEND);
+            view.hand = column<uint8_t>(chunk, layout, HistoryLayout::HAND);
+            view.flags = column<uint8_t>(chunk, layout, HistoryLayout::FLAGS);
+            view.playerTotal = column<uint8_t>(chunk, layout, HistoryLayout::PLAYERTOTAL);
+            view.dealerTotal = column<uint8_t>(chunk, layout, HistoryLayout::DEALERTOTAL);
+            view.upcard = column<uint8_t>(chunk, layout, HistoryLayout::UPCARD);
+            view.outcome = column<int8_t>(chunk, layout, HistoryLayout::OUTCOME);
+            view.playerCards = column<uint8_t>(chunk, layout, HistoryLayout::PLAYERCARDS);
+            view.dealerCards = column<uint8_t>(chunk, layout, HistoryLayout::DEALERCARDS);
+            if (!validRows(view, header)){
+                return fail("damaged rows in the chunk at byte " + to_string(at));
+            }
+            visit(view);
+            at += header.bytes;
+        }
+        return true;
+    }
+};
+
+
+class Game : public GameStats{
+public:
+    //Declared first, everything below that takes memory from it has to go after.
+    TableArena m_arena;
+    /*
+    used to make a COPY of the player to use during run.
+    */
+    pmr::deque<unique_ptr<Player>> m_players;
+    Dealer m_dealer;
+    GameStats m_stats;
+    ActionLog m_actionLog;
+    ProfileStore m_profiles;
+    priority_queue<pair<int, string>> m_events;
+    
+    /*
+    
+    flag class for game flow logic, will be of help with flow chart design and game loop.
+    
+    */
+    enum class GameState { BETTING, DEALING, INSURANCE, PLAYER_TURN, DEALER_TURN, PAYOUT, CLEANUP };
+    GameState m_currentState;
+
+    //Headless tables skip all of the table rendering, for unattended simulation runs.
+    bool m_headless;
+    
+    //Seat numbers handed out so far, so every player who joins gets their own.
+    int m_nextSeat;
+    //Rounds started at this table, stamped on every logged event.
+    uint64_t m_round;
+
+    //Where the round is up to: whose bet or turn it is (an index into m_players), and whether their turn has started.
+    size_t m_turn;
+    bool m_turnStarted;
+    bool m_roundActive;
+
+    //With batched dealers the round parks at DEALER_TURN until playDealer(), so a scheduler can play many tables' dealers in one go.
+    bool m_batchDealer;
+    bool m_dealerDue;
+
+    TableRules m_rules;
+    //TableRules::doubleTotals() for a hand as dealt ([0]) and for a split hand ([1], 0 without double after split).
+    array<uint32_t, 2> m_doubleTotals;
+
+    //Reused every round so settling doesn't allocate.
+    HandBatch m_settling;
+    //Rounds played since the last player sat down, the first one after a join is still setting up their stats.
+    uint64_t m_settledRounds;
+    //Picked out by cleanup() for findMinMaxMoney(), nullptr when the table's empty.
+    Player* m_richest;
+    Player* m_poorest;
+
+    //The seed the shoe was last given, always known so a recording can start from it.
+    uint64_t m_seedValue;
+    uint32_t m_seedStream;
+    ReplayRecorder m_replay;
+    HandHistoryWriter m_history;
+#ifdef BLKJCK_INSTRUMENT
+    TableMetrics m_metrics;
+#endif
+    
+    Game() : m_players(m_arena.resource()), m_currentState(GameState::BETTING), m_headless(false), m_nextSeat(0), m_round(0),
+             m_turn(0), m_turnStarted(false), m_roundActive(false), m_batchDealer(false), m_dealerDue(false),
+             m_doubleTotals{m_rules.doubleTotals(), m_rules.doubleAfterSplit ? m_rules.doubleTotals() : 0u},
+             m_settling(m_arena.resource()), m_settledRounds(0), m_richest(nullptr), m_poorest(nullptr), m_seedValue(random_device{}()), m_seedStream(0){
+        m_dealer.seedDeck(m_seedValue);
+    }
+    ~Game(){
+        stopRecording();
+        stopHandHistory();
+    }
+    
+    // Player management
+    void addPlayer(const Player& name){
+        addPlayer(make_unique<Player>(name));
+    }
+    //Seats an already built player (bots and such), keeping whatever subclass it is.
+    void addPlayer(unique_ptr<Player> player){
+        player->setSeat(m_nextSeat++);
+        m_actionLog.registerName(player->getSeat(), player->getName());
+        logAction(LogEventType::JOINED, player->getSeat());
+        if (m_replay.isOpen()){
+            recordJoin(*player);
+        }
+        m_stats.addPlayer(player->getName());
+        m_players.push_back(move(player));
+        //Room for every seat splitting all the way, so payouts never have to grow the batch.
+        m_settling.reserve(m_players.size() * MAXHANDS);
+        m_settledRounds = 0;
+    }
+    //Swaps in a fresh shoe of numDecks decks, with the cut card at the given penetration.
+    void configureShoe(int numDecks, double penetration = DEFAULTPENETRATION){
+        m_dealer.configureShoe(numDecks, penetration);
+        m_rules.numDecks = m_dealer.getDeck().getNumDecks();
+        if (m_replay.isOpen()){
+            m_replay.shoe(numDecks, penetration);
+        }
+        if (m_history.isOpen()){
+            m_history.setRules(m_rules);
+        }
+    }
+    //Changes the house rules, between rounds. a different deck count swaps the shoe like configureShoe() does.
+    void setRules(const TableRules& rules){
+        if (rules.numDecks != m_rules.numDecks){
+            configureShoe(rules.numDecks, m_dealer.getDeck().getPenetration());
+        }
+        int numDecks = m_rules.numDecks;
+        m_rules = rules;
+        m_rules.numDecks = numDecks;
+        m_rules.maxHands = min(max(rules.maxHands, 1), MAXHANDS);
+        m_dealer.setHitsSoft17(m_rules.hitSoft17);
+        m_doubleTotals[0] = m_rules.doubleTotals();
+        m_doubleTotals[1] = m_rules.doubleAfterSplit ? m_doubleTotals[0] : 0u;
+        if (m_replay.isOpen()){
+            m_replay.rules(m_rules);
+        }
+        if (m_history.isOpen()){
+            m_history.setRules(m_rules);
+        }
+    }
+    const TableRules& getRules() const{
+        return m_rules;
+    }
+    //The count bet policies read off the shoe, hi-lo unless told otherwise.
+    void setCountSystem(const CountSystem& system){
+        m_dealer.setCountSystem(system);
+        if (m_replay.isOpen()){
+            m_replay.countSystem(system);
+        }
+    }
+    //What the table shows everyone before bets go down.
+    BetContext betContext() const{
+        BetContext table;
+        table.trueCount = m_dealer.getDeck().trueCount();
+        return table;
+    }
+    //Seeds the dealer's shoe. stream picks an independent sequence for the same seed.
+    void seed(uint64_t seedValue, uint32_t stream = 0){
+        m_dealer.seedDeck(seedValue, stream);
+        m_seedValue = seedValue;
+        m_seedStream = stream;
+        if (m_replay.isOpen()){
+            m_replay.seed(seedValue, stream);
+        }
+        if (m_history.isOpen()){
+            m_history.seeded(seedValue, stream);
+        }
+    }
+    //Shuffles the whole shoe, the way every session starts.
+    void shuffle(){
+        m_dealer.shuffleDeck();
+        logAction(LogEventType::SHUFFLED);
+        if (m_replay.isOpen()){
+            m_replay.shuffle();
+        }
+    }
+    /*
+        starts writing a replay of this table to path. the shoe is put back to a fresh one on the
+        current seed first, and whoever is already seated goes down as joining, so the file starts
+        from a state the replay can rebuild exactly.
+    */
+    bool startRecording(const string& path){
+        stopRecording();
+        if (!m_replay.open(path)){
+            return false;
+        }
+        const Deck& shoe = m_dealer.getDeck();
+        configureShoe(shoe.getNumDecks(), shoe.getPenetration());
+        seed(m_seedValue, m_seedStream);
+        m_replay.rules(m_rules);
+        m_replay.countSystem(m_dealer.getDeck().getCountSystem());
+        for (const auto& p : m_players){
+            recordJoin(*p);
+        }
+        return true;
+    }
+    void recordJoin(const Player& p){
+        m_replay.join(p.getSeat(), p.getName(), p.getMoney(), p.getFlatBet());
+        const BotPlayer* bot = dynamic_cast<const BotPlayer*>(&p);
+        if (bot && bot->getBetPolicy()){
+            BetContext last = bot->lastRound();
+            m_replay.policy(p.getSeat(), *bot->getBetPolicy(), last.lastBet, last.lastNet);
+        }
+    }
+    void stopRecording(){
+        if (m_replay.isOpen()){
+            m_replay.finish(m_players);
+        }
+    }
+    //Writes every hand settled from here on to path, in the columnar hand history format.
+    bool startHandHistory(const string& path){
+        return m_history.open(path, m_seedValue, m_seedStream, m_rules);
+    }
+    void stopHandHistory(){
+        string path = m_history.path();
+        if (!m_history.close()){
+            cout << "Couldn't write the hand history to " << path << ", it's incomplete." << endl;
+        }
+    }
+    void setHeadless(bool headless){
+        m_headless = headless;
+    }
+    bool isHeadless() const{
+        return m_headless;
+    }
+    /*
+        use find_if function to search through the deque of unique pointers and return the player pointer if
+        the getName() matches the targeted name. afterwards, check to see where the returned player is, and remove it
+        log against for better game flow.
+    */
+    void removePlayer(const string& name){
+        auto rP = find_if(m_players.begin(), m_players.end(), [&name](const unique_ptr<Player>&p) 
+        {return p->getName() == name;}
+        );
+
+        if (rP != m_players.end()){
+            logAction(LogEventType::FORFEITED, (*rP)->getSeat());
+            if (m_replay.isOpen()){
+                m_replay.leave((*rP)->getSeat());
+            }
+            m_players.erase(rP);
+        }
+    }
+
+
+    
+    // magnum opus
+    void play(){
+        if (m_players.empty()){
+            cout << "No players at table.\n";
+            return;
+        }
+
+        shuffle();
+
+        bool contPlay = true;
+        while(contPlay){
+            beginRound();
+            //The table only ever stops to wait on someone at the terminal, so ask them and hand it back.
+            while (isRoundActive() && waitingSeat() >= 0){
+                answerFromTerminal(*playerAt(waitingSeat()));
+            }
+
+            cout << "\nContinue playing? (y/n):" ;
+            char gChoice;
+            cin >> gChoice;
+            cin.ignore(numeric_limits<streamsize>::max(), '\n');
+            contPlay = (gChoice == 'y' || gChoice == 'Y');
+        }
+
+    }
+    /*
+        one full round, betting through cleanup, for tables where nobody waits on outside input.
+        the simulator just calls it in a loop.
+    */
+    void playRound(){
+#ifdef BLKJCK_COUNT_ALLOCATIONS
+        uint64_t before = allocationCount();
+        bool settled = m_headless && m_settledRounds > 0;
+#endif
+        beginRound();
+        m_settledRounds++;
+#ifdef BLKJCK_COUNT_ALLOCATIONS
+        assert((!settled || allocationCount() == before) && "a settled headless round allocated");
+#endif
+    }
+    //Asks whoever the table is waiting on at the terminal, and hands their answer over.
+    void answerFromTerminal(Player& p){
+        if (m_currentState == GameState::BETTING){
+            int bet = p.chooseBet(betContext());
+            if (!submitBet(p.getSeat(), bet)){
+                cout << "Invalid bet. You only have $" << p.getMoney() << ". ";
+            }
+            return;
+        }
+        if (m_currentState == GameState::INSURANCE){
+            submitInsurance(p.getSeat(), p.takesInsurance(p.getBet() / 2));
+            return;
+        }
+        submitAction(p.getSeat(), p.chooseAction(p.getHand(), m_dealer.getUpcard(), canDouble(p), canSplit(p), canSurrender(p)));
+    }
+
+    /*
+        the round as a state machine, so a table can stop partway and pick back up later.
+        beginRound() starts the betting and advance() walks the states from there, asking players
+        as it goes. when it reaches a seat that awaitsInput() it just returns, and the round carries on
+        once submitBet()/submitAction() answers for that seat. waitingSeat() says who that is.
+    */
+    void beginRound(){
+        m_round++;
+        m_turn = 0;
+        m_turnStarted = false;
+        m_roundActive = true;
+        BLKJCK_COUNT_ROUND(m_metrics);
+        if (m_replay.isOpen()){
+            m_replay.round();
+        }
+        setState(GameState::BETTING);
+        if (!m_headless){
+            cout << "\n===== PLACING BETS =====\n";
+        }
+        advance();
+    }
+    /*
+        walks the states until the round is over or has to wait. a shoe run dry partway calls the round
+        off, and it picks up again at cleanup, which doesn't need any cards.
+    */
+    void advance(){
+        try{
+            advanceStates();
+        }
+        catch (const ShoeExhausted&){
+            callOffRound();
+            advanceStates();
+        }
+    }
+    void advanceStates(){
+        while (m_roundActive){
+            BLKJCK_TIME_PHASE(m_metrics, m_currentState);
+            switch (m_currentState){
+                case GameState::BETTING:
+                    if (!placeBets()){
+                        return;
+                    }
+                    //Everybody may have walked off before betting, then there's nothing to deal.
+                    setState(m_players.empty() ? GameState::CLEANUP : GameState::DEALING);
+                    break;
+                case GameState::DEALING:
+                    deal();
+                    m_turn = 0;
+                    m_turnStarted = false;
+                    setState(GameState::INSURANCE);
+                    if (!m_headless){
+                        cout << "\n===== DEALING CARDS =====\n";
+                    }
+                    break;
+                case GameState::INSURANCE:
+                    if (!offerInsurance()){
+                        return;
+                    }
+                    m_turn = 0;
+                    m_turnStarted = false;
+                    //A dealer blackjack found on the peek settles the round before anyone plays into it.
+                    setState(dealerPeeks() ? GameState::DEALER_TURN : GameState::PLAYER_TURN);
+                    break;
+                case GameState::PLAYER_TURN:
+                    if (!playerTurns()){
+                        return;
+                    }
+                    setState(GameState::DEALER_TURN);
+                    break;
+                case GameState::DEALER_TURN:
+                    if (m_batchDealer && !m_dealerDue){
+                        return;
+                    }
+                    m_dealerDue = false;
+                    dealerTurn();
+                    setState(GameState::PAYOUT);
+                    break;
+                case GameState::PAYOUT:
+                    payouts();
+                    setState(GameState::CLEANUP);
+                    break;
+                case GameState::CLEANUP:
+                    cleanup();
+                    findMinMaxMoney();
+                    m_roundActive = false;
+                    break;
+            }
+        }
+    }
+    bool isRoundActive() const{
+        return m_roundActive;
+    }
+    void setBatchDealer(bool batch){
+        m_batchDealer = batch;
+    }
+    //True when a batched round has finished the players' turns and is parked waiting on playDealer().
+    bool awaitingDealer() const{
+        return m_roundActive && m_currentState == GameState::DEALER_TURN;
+    }
+    //Plays the dealer's hand of a parked round and settles it.
+    void playDealer(){
+        if (!awaitingDealer()){
+            return;
+        }
+        m_dealerDue = true;
+        advance();
+    }
+    //Seat the round is stopped on, -1 if it isn't waiting for anyone.
+    int waitingSeat() const{
+        if (!m_roundActive || m_turn >= m_players.size()){
+            return -1;
+        }
+        if (m_currentState != GameState::BETTING && m_currentState != GameState::INSURANCE
+            && m_currentState != GameState::PLAYER_TURN){
+            return -1;
+        }
+        return m_players[m_turn]->getSeat();
+    }
+    //Answers the bet the table is waiting on. false if it isn't that seat's bet or the amount is no good.
+    bool submitBet(int seat, int amount){
+        if (m_currentState != GameState::BETTING || waitingSeat() != seat || !m_players[m_turn]->placeBet(amount)){
+            return false;
+        }
+        logAction(LogEventType::BET, seat, amount);
+        if (m_replay.isOpen()){
+            m_replay.bet(seat, amount);
+        }
+        m_turn++;
+        advance();
+        return true;
+    }
+    //Answers the insurance offer the table is waiting on.
+    bool submitInsurance(int seat, bool take){
+        if (m_currentState != GameState::INSURANCE || waitingSeat() != seat){
+            return false;
+        }
+        if (m_replay.isOpen()){
+            m_replay.insurance(seat, take);
+        }
+        takeInsurance(*m_players[m_turn], take);
+        m_turn++;
+        advance();
+        return true;
+    }
+    //Plays one decision for the seat whose turn it is, on the hand they're playing.
+    bool submitAction(int seat, Action choice){
+        if (m_currentState != GameState::PLAYER_TURN || waitingSeat() != seat){
+            return false;
+        }
+        Player& p = *m_players[m_turn];
+        //Refused before anything is recorded, so the seat just gets asked again.
+        if (!allows(p, choice)){
+            return false;
+        }
+        if (m_replay.isOpen()){
+            m_replay.action(seat, choice);
+        }
+        try{
+            if (applyAction(p, choice)){
+                finishHand(p);
+            }
+        }
+        catch (const ShoeExhausted&){
+            callOffRound();
+        }
+        advance();
+        return true;
+    }
+    //Takes a seat away from the table before it has bet this round, like when they get up and walk off.
+    bool forfeitSeat(int seat){
+        if (m_currentState != GameState::BETTING){
+            return false;
+        }
+        for (size_t i = m_turn; i < m_players.size(); i++){
+            if (m_players[i]->getSeat() == seat){
+                logAction(LogEventType::FORFEITED, seat);
+                if (m_replay.isOpen()){
+                    m_replay.forfeit(seat);
+                }
+                m_players.erase(m_players.begin() + i);
+                advance();
+                return true;
+            }
+        }
+        return false;
+    }
+    Player* playerAt(int seat){
+        for (auto& p : m_players){
+            if (p->getSeat() == seat){
+                return p.get();
+            }
+        }
+        return nullptr;
+    }
+    //Two cards on a total the rules let you double, after a split only with double after split.
+    bool canDouble(const Player& p) const{
+        const Hand& hand = p.getHand();
+        return hand.size() == 2 && p.getBet() <= p.getMoney() && ((m_doubleTotals[p.getNumHands() > 1] >> hand.getTotal()) & 1);
+    }
+    bool canSplit(const Player& p) const{
+        return p.canSplit() && p.getNumHands() < m_rules.maxHands;
+    }
+    //Late surrender, so only as the first decision on the hand that was dealt.
+    bool canSurrender(const Player& p) const{
+        return m_rules.lateSurrender && p.getNumHands() == 1 && p.getHand().size() == 2;
+    }
+    //Whether the table lets p make this choice on the hand in front of them, hitting and standing always are.
+    bool allows(const Player& p, Action choice) const{
+        switch (choice){
+            case Action::DOUBLE:
+                return canDouble(p);
+            case Action::SPLIT:
+                return canSplit(p);
+            case Action::SURRENDER:
+                return canSurrender(p);
+            default:
+                return true;
+        }
+    }
+    bool canInsure(const Player& p) const{
+        int cost = p.getBet() / 2;
+        return cost > 0 && cost <= p.getMoney();
+    }
+
+    //Takes bets from everyone who can answer right away, returns false if it has to wait on a seat.
+    bool placeBets(){
+        BetContext table = betContext();
+        for (; m_turn < m_players.size(); m_turn++){
+            auto& p = m_players[m_turn];
+            if (p->awaitsInput()){
+                return false;
+            }
+            int bet = p->chooseBet(table);
+
+            while (!p->placeBet(bet)){
+                cout << "Invalid bet. You only have $" << p->getMoney() << ". ";
+                bet = p->chooseBet(table);
+            }
+
+            logAction(LogEventType::BET, p->getSeat(), bet);
+        }
+        return true;
+    }
+
+    void deal(){
+        if (!m_headless){
+            cout << "\n===== DEALING CARDS =====\n";
+        }
+        for (auto& p : m_players){
+            p->clearHands();
+        }
+        m_dealer.clearHands();
+
+        /*
+            while performance wise unconventional, i want to stick to real game flow standard
+            usually the deal is done one and a time iteratively, so that's what i'm going with here
+            and probably for any other game related instance.
+        */
+
+        for (int pass = 0; pass < 2; pass++){
+            for(auto& p : m_players){
+                dealTo(*p, p->getSeat());
+            }
+            dealTo(m_dealer, DEALER_SEAT);
+        }
+
+        if (!m_headless){
+            displayTable();
+        }
+
+    }
+    //Goes round the table offering insurance under a dealer ace, false if it has to wait on a seat.
+    bool offerInsurance(){
+        if (!m_dealer.getUpcard().isAce()){
+            return true;
+        }
+        for (; m_turn < m_players.size(); m_turn++){
+            Player& p = *m_players[m_turn];
+            if (!canInsure(p)){
+                continue;
+            }
+            if (p.awaitsInput()){
+                return false;
+            }
+            takeInsurance(p, p.takesInsurance(p.getBet() / 2));
+        }
+        return true;
+    }
+    void takeInsurance(Player& p, bool take){
+        if (!take || !p.insure()){
+            return;
+        }
+        logAction(LogEventType::INSURED, p.getSeat(), p.getInsurance());
+        if (!m_headless){
+            cout << p.getName() << " takes insurance for $" << p.getInsurance() << ".\n";
+        }
+    }
+    //The dealer checks under an ace or a ten, true if the hole card makes a blackjack.
+    bool dealerPeeks(){
+        if (m_dealer.getUpcard().getValue() < 10 || !m_dealer.isBlackjack()){
+            return false;
+        }
+        logAction(LogEventType::BLACKJACK, DEALER_SEAT);
+        if (!m_headless){
+            cout << "\nThe dealer peeks and has blackjack!\n";
+        }
+        return true;
+    }
+    //Plays out turns until everyone is done (true), or until it's the turn of a seat it has to wait on.
+    bool playerTurns(){
+        const Card& upcard = m_dealer.getUpcard();
+
+        while (m_turn < m_players.size()){
+            Player& p = *m_players[m_turn];
+            if (!m_turnStarted){
+                m_turnStarted = true;
+                if (startTurn(p)){
+                    endTurn();
+                    continue;
+                }
+            }
+            //A hand split off earlier gets its second card once play reaches it.
+            if (p.getHand().size() == 1 && drawToSplit(p)){
+                finishHand(p);
+                continue;
+            }
+            if (p.awaitsInput()){
+                return false;
+            }
+            if (applyAction(p, p.chooseAction(p.getHand(), upcard, canDouble(p), canSplit(p), canSurrender(p)))){
+                finishHand(p);
+            }
+        }
+        return true;
+    }
+    //Announces a player's turn, true if there's nothing for them to decide (a blackjack).
+    bool startTurn(Player& p){
+        if (!m_headless){
+            cout << "\n" << p.getName() << "'s turn: \n";
+            p.showHand();
+        }
+
+        if (p.isBlackjack()){
+            if (!m_headless){
+                cout << "Blackjack! " << p.getName() << " stands.\n";
+            }
+            logAction(LogEventType::BLACKJACK, p.getSeat());
+            return true;
+        }
+        return false;
+    }
+    void endTurn(){
+        m_turn++;
+        m_turnStarted = false;
+    }
+    //Moves the player on to their next split hand, or ends their turn after the last one.
+    void finishHand(Player& p){
+        if (!p.nextHand()){
+            endTurn();
+        }
+    }
+    //Carries out one decision, true once the hand being played is over (stood, busted, doubled or surrendered).
+    bool applyAction(Player& p, Action choice){
+        if (choice == Action::SPLIT && canSplit(p)){
+            p.split();
+            logAction(LogEventType::SPLIT, p.getSeat(), p.getNumHands());
+            if (!m_headless){
+                cout << p.getName() << " splits, $" << p.getBet() << " on each hand.\n";
+            }
+            return drawToSplit(p);
+        }
+        if (choice == Action::SURRENDER && canSurrender(p)){
+            p.surrender();
+            logAction(LogEventType::SURRENDERED, p.getSeat(), p.getBet());
+            if (!m_headless){
+                cout << p.getName() << " surrenders.\n";
+            }
+            return true;
+        }
+
+        bool doubled = (choice == Action::DOUBLE && canDouble(p) && p.doubleDown());
+        if (!doubled && choice != Action::HIT){
+            stand(p);
+            return true;
+        }
+
+        if (doubled){
+            logAction(LogEventType::DOUBLED, p.getSeat(), p.getBet());
+        }
+        Card nC = m_dealer.deal();
+        p.getHandRef().add(nC);
+        logAction(LogEventType::HIT, p.getSeat(), 0, nC);
+        if (p.isBusted()){
+            logAction(LogEventType::BUSTED, p.getSeat(), p.getHand().getTotal());
+        }
+
+        if (!m_headless){
+            if (doubled){
+                cout << p.getName() << " doubles down to $" << p.getBet() << ".\n";
+            }
+            cout << p.getName() << " receives: " << nC.getRank() << " of " << nC.getSuit() << endl;
+
+            if (p.isBusted()){
+                cout << p.getName() << " busts with " << p.getHand().getTotal() << "!\n";
+            }
+            else{
+                cout << p.getName() << " has " << p.getHand().getTotal() << ".\n";
+            }
+        }
+
+        if (p.isBusted()){
+            return true;
+        }
+        if (doubled){
+            stand(p);
+            return true;
+        }
+        return false;
+    }
+    //Deals a split hand its second card. split aces stand on it, and then it's true that the hand is done.
+    bool drawToSplit(Player& p){
+        Card nC = m_dealer.deal();
+        p.getHandRef().add(nC);
+        logAction(LogEventType::HIT, p.getSeat(), 0, nC);
+        if (!m_headless){
+            p.showHand();
+        }
+        if (p.hasSplitAces()){
+            stand(p);
+            return true;
+        }
+        return false;
+    }
+    //The dealer's draws, with the soft 17 rule compiled in so each card only costs a look at the total.
+    template <bool HitSoft17>
+    void dealerDraws(){
+        while (Dealer::hitsOn<HitSoft17>(m_dealer.getHand().getTotal(), m_dealer.getHand().isSoft())){
+            Card nC = m_dealer.deal();
+            m_dealer.getHandRef().add(nC);
+            logAction(LogEventType::DEALER_HIT, DEALER_SEAT, 0, nC);
+            if (!m_headless){
+                cout << "Dealer recieves: " << nC.getRank() << " of " << nC.getSuit() << endl;
+                cout << "Dealer has " << m_dealer.getHand().getTotal() << ".\n";
+            }
+        }
+    }
+    /*
+        every card of the shoe is out on the table (a small shoe, lots of seats and splits), so nobody
+        can be dealt to. the round doesn't count: everyone gets their stakes back and it goes straight to
+        cleanup, which puts the cards on the discard pile for the next one.
+    */
+    void callOffRound(){
+        for (auto& p : m_players){
+            p->returnBets();
+        }
+        if (!m_headless){
+            cout << "\nThe shoe has run out of cards, the round is called off and every bet goes back.\n";
+        }
+        setState(GameState::CLEANUP);
+    }
+    void stand(Player& p){
+        logAction(LogEventType::STOOD, p.getSeat(), p.getHand().getTotal());
+        if (!m_headless){
+            cout << p.getName() << " stands with " << p.getHand().getTotal() << ".\n";
+        }
+    }
+    void dealerTurn(){
+        bool cleanSweep = true;
+        for (auto& p : m_players){
+            if (p->hasLiveHand()){
+                cleanSweep = false;
+                break;
+            }
+        }
+
+        if (!m_headless){
+            cout << "\n===== DEALERS TURN =====\n";
+            m_dealer.showHand(true);
+        }
+
+        if (cleanSweep){
+            if (!m_headless){
+                cout << "Wow! All players have busted, the Dealer wins!\n";
+            }
+            logAction(LogEventType::ALL_BUSTED);
+            return;
+        }
+
+        if (m_rules.hitSoft17){
+            dealerDraws<true>();
+        }
+        else{
+            dealerDraws<false>();
+        }
+
+        int dealerTotal = m_dealer.getHand().getTotal();
+        logAction(m_dealer.isBusted() ? LogEventType::DEALER_BUSTED : LogEventType::DEALER_STOOD, DEALER_SEAT, dealerTotal);
+
+        if (m_headless){
+            return;
+        }
+        if(m_dealer.isBusted()){
+            cout << "Dealer busts with " << dealerTotal << "!\n";
+        }
+        else{
+            cout << "Dealer stands with " << dealerTotal << "!\n";
+        }
+
+    }
+    /*
+    
+        payout function based on hand totals and if player or dealer has achieved a blackjack.
+        the hands go through settleHands() as a batch of one table, the same kernel a simulation can
+        run over many tables' hands at once, and then get paid out seat by seat.
+    
+    */
+    void payouts(){
+        if (!m_headless){
+            cout << "\n===== RESULTS =====\n";
+        }
+
+        m_settling.clear();
+        appendHands(m_settling);
+        settleHands(m_settling, m_rules.blackjackPays);
+        applySettlement(m_settling, 0);
+
+        saveProfiles();
+    }
+    //Adds every hand still to be settled to batch, seat by seat and then split hand by split hand.
+    void appendHands(HandBatch& batch) const{
+        int dT = m_dealer.getHand().getTotal();
+        bool dBJ = m_dealer.isBlackjack();
+        for (const auto& p : m_players){
+            //A surrender is settled on its own terms, it never goes up against the dealer.
+            if (p->hasSurrendered()){
+                continue;
+            }
+            for (int h = 0; h < p->getNumHands(); h++){
+                batch.add(p->getHand(h).getTotal(), p->isBlackjack(), dT, dBJ, p->getBet(h));
+            }
+        }
+    }
+    /*
+        pays out this table's hands, which start at index first of a batch settleHands() has been over,
+        in the order appendHands() put them there. insurance and surrenders are paid here directly.
+    */
+    void applySettlement(const HandBatch& batch, size_t first){
+        bool dBJ = m_dealer.isBlackjack();
+        size_t next = first;
+
+        for (auto& player : m_players){
+            Player& p = *player;
+            int insured = 0;
+            if (p.getInsurance() > 0){
+                insured = settleInsurance(p, dBJ);
+            }
+            if (p.hasSurrendered()){
+                int bet = p.getBet(0);
+                int net = settleSurrender(p);
+                if (m_history.isOpen()){
+                    recordHistory(p, 0, bet, net, insured, OUTCOME_LOSS);
+                }
+            }
+            else{
+                for (int h = 0; h < p.getNumHands(); h++, next++){
+                    payHand(p, h, static_cast<HandOutcome>(batch.outcome[next]), batch.net[next]);
+                    if (m_history.isOpen()){
+                        recordHistory(p, h, batch.bet[next], batch.net[next], h == 0 ? insured : 0, static_cast<HandOutcome>(batch.outcome[next]));
+                    }
+                }
+            }
+            m_stats.updateHighScore(p.getName(), p.getMoney());
+        }
+    }
+    /*
+        pays one hand off what the kernel worked out. the kernel only hands back numbers, the reason
+        for the result is worked out again here for the table talk.
+    */
+    void payHand(Player& p, int h, HandOutcome result, int net){
+        int dT = m_dealer.getHand().getTotal();
+        bool dB = m_dealer.isBusted();
+        bool dBJ = m_dealer.isBlackjack();
+        const string& name = p.getName();
+        const Hand& hand = p.getHand(h);
+        int bet = p.getBet(h);
+        int pT = hand.getTotal();
+
+        p.settle(h, net);
+        if (result == OUTCOME_LOSS){
+            m_stats.recordLoss(name);
+        }
+        else if (result != OUTCOME_PUSH){
+            m_stats.recordWin(name);
+        }
+
+        if (!m_headless){
+            cout << name;
+            if (p.getNumHands() > 1){
+                cout << " (hand " << h + 1 << ")";
+            }
+            cout << ": ";
+            switch (result){
+                case OUTCOME_LOSS:
+                    if (hand.isBusted()){
+                        cout << "Busted and lost $" << bet << ".\n";
+                    }
+                    else if (dBJ && !p.isBlackjack()){
+                        cout << "Lost $" << bet << " the dealer's blackjack. \n";
+                    }
+                    else{
+                        cout << "Lost $" << bet << " with " << pT << " under dealer's " << dT << ".\n";
+                    }
+                    break;
+                case OUTCOME_WIN:
+                    if (dB){
+                        cout << "Won $" << bet << " (dealer busted).\n";
+                    }
+                    else{
+                        cout << "Won $ " << bet << " with " << pT << " over dealer's " << dT << ".\n";
+                    }
+                    break;
+                case OUTCOME_BLACKJACK:
+                    cout << "Blackjack! Won $" << net << ".\n";
+                    break;
+                case OUTCOME_PUSH:
+                    cout << "Push. Bet of $" << bet << " returned.\n";
+                    break;
+            }
+        }
+
+        if (net > 0){
+            logAction(LogEventType::WON, p.getSeat(), net);
+        }
+        else if (net < 0){
+            logAction(LogEventType::LOST, p.getSeat(), -net);
+        }
+        else{
+            logAction(LogEventType::PUSHED, p.getSeat(), bet);
+        }
+        m_stats.recordHand(p.getSeat(), m_dealer.getUpcard().getValue(), bet, net);
+    }
+    //One settled hand into the hand history, the bet as it was before settling cleared it.
+    void recordHistory(const Player& p, int h, int bet, int net, int insured, HandOutcome result){
+        const Hand& hand = p.getHand(h);
+        const Hand& dealer = m_dealer.getHand();
+        uint8_t flags = 0;
+        flags |= p.hasDoubled(h) ? HISTORY_DOUBLED : 0;
+        flags |= p.getNumHands() > 1 ? HISTORY_SPLIT : 0;
+        flags |= p.hasSurrendered() ? HISTORY_SURRENDERED : 0;
+        flags |= insured ? HISTORY_INSURED : 0;
+        flags |= (hand.isBlackjack() && p.getNumHands() == 1) ? HISTORY_BLACKJACK : 0;
+        flags |= hand.isBusted() ? HISTORY_BUSTED : 0;
+        flags |= m_dealer.isBlackjack() ? HISTORY_DEALER_BLACKJACK : 0;
+        flags |= m_dealer.isBusted() ? HISTORY_DEALER_BUSTED : 0;
+        m_history.addHand(m_round, p.getSeat(), h, flags, hand, bet, net, insured, result, dealer, m_dealer.getUpcard().getValue());
+    }
+    //Half the bet comes back, the house keeps the odd dollar. returns what the player made on it.
+    int settleSurrender(Player& p){
+        int bet = p.getBet(0);
+        int net = bet / 2 - bet;
+
+        p.settle(0, net);
+        m_stats.recordLoss(p.getName());
+        if (!m_headless){
+            cout << p.getName() << ": Surrendered, $" << bet + net << " of $" << bet << " returned.\n";
+        }
+        logAction(LogEventType::LOST, p.getSeat(), -net);
+        m_stats.recordHand(p.getSeat(), m_dealer.getUpcard().getValue(), bet, net);
+        return net;
+    }
+    //Returns what the insurance made for the player.
+    int settleInsurance(Player& p, bool dealerBlackjack){
+        int cost = p.getInsurance();
+        int net = p.settleInsurance(dealerBlackjack);
+
+        if (!m_headless){
+            cout << p.getName() << ": ";
+            if (net > 0){
+                cout << "Insurance pays $" << net << ".\n";
+            }
+            else{
+                cout << "Insurance of $" << cost << " lost.\n";
+            }
+        }
+        logAction(net > 0 ? LogEventType::INSURANCE_PAID : LogEventType::INSURANCE_LOST, p.getSeat(), net > 0 ? net : cost);
+        m_stats.recordSideBet(p.getSeat(), cost, net);
+        return net;
+    }
+    void cleanup(){
+        collectCards();
+
+        if (m_dealer.shoeNeedsReshuffle()){
+            m_dealer.reshuffle();
+            logAction(LogEventType::SHUFFLED);
+            if (!m_headless){
+                cout << "The cut card is out, dealer reshuffles the shoe.\n";
+            }
+        }
+
+        //One pass over the table does the bankroll stats, the richest and poorest, and who's out.
+        m_richest = m_poorest = nullptr;
+        auto rP = m_players.begin();
+        while (rP != m_players.end()){
+            m_stats.recordBankroll((*rP)->getMoney());
+            if ((*rP)->getMoney()<=0){
+                if (!m_headless){
+                    cout << (*rP)->getName() << " is out of money and forfeits the game.\n";
+                }
+                logAction(LogEventType::OUT_OF_MONEY, (*rP)->getSeat());
+                rP = m_players.erase(rP);
+            }
+            else{
+                if (!m_richest || (*rP)->getMoney() > m_richest->getMoney()){
+                    m_richest = rP->get();
+                }
+                if (!m_poorest || (*rP)->getMoney() < m_poorest->getMoney()){
+                    m_poorest = rP->get();
+                }
+                rP++;
+            }
+        }
+        processEvents();
+
+        if (!m_headless){
+            m_stats.displayStats();
+            m_stats.displayHighScores();
+        }
+    }
+    /*
+        every card on the table goes onto the dealer's discard pile once the round is over,
+        that way the deck can be rebuilt from it instead of slowly running out.
+    */
+    //Deals one card to a hand at the table and logs it, face down cards included.
+    void dealTo(Player& who, int seat){
+        Card card = m_dealer.deal();
+        who.getHandRef().add(card);
+        logAction(LogEventType::DEALT, seat, 0, card);
+    }
+    void collectCards(){
+        for (auto& p : m_players){
+            for (int h = 0; h < p->getNumHands(); h++){
+                for (const auto& card : p->getHand(h)){
+                    m_dealer.discard(card);
+                }
+            }
+            p->clearHands();
+        }
+        for (const auto& card : m_dealer.getHand()){
+            m_dealer.discard(card);
+        }
+        m_dealer.clearHands();
+    }
+
+    /*
+        this function stays OUT of the playerstats class because it's to be used in between rounds of blackjack.
+        cleanup() already picked out the richest and poorest while it went round the table, this just says so.
+    */
+    void findMinMaxMoney(){
+        if (m_headless){
+            return;
+        }
+        if (!m_richest || !m_poorest){
+            cout <<"No players at table to value!\n";
+            return ;
+        }
+
+        cout << "\n=====PLAYER MONEY STATS=====\n";
+        cout << "Current Top Earner: " << m_richest->getName() << " with $" << m_richest->getMoney() << endl;
+        cout << "Current Low Earner: " << m_poorest->getName() << " with $" << m_poorest->getMoney() << endl;
+    }
+    
+    // Game state management
+    void setState(GameState state){
+        m_currentState = state;
+    }
+    GameState getState() const{
+        return m_currentState;
+    }
+    
+    // Game utilities
+    void displayTable() const{
+        cout << "\n===== TABLE STATUS =====\n";
+        m_dealer.showHand(false);
+        for (const auto& p: m_players){
+            cout << p->getName() << " ($" << p->getMoney() << ", bet: $" << p->getBet() << "): ";
+            p->getHand().toString();
+            cout << endl;
+        }
+    }
+    //Records into the ring buffer, nothing gets turned into text here.
+    void logAction(LogEventType type, int seat = DEALER_SEAT, int amount = 0, Card card = Card()){
+        BLKJCK_COUNT_EVENT(m_metrics, type);
+        m_actionLog.record(type, seat, m_round, amount, card);
+    }
+    //Opens the saved profile store, profiles then survive between runs.
+    bool openProfiles(const string& path){
+        return m_profiles.open(path);
+    }
+    //Slots move when the store grows, so seated players look theirs up again after an insert.
+    void refreshProfileSlots(){
+        for (auto& p : m_players){
+            if (p->getProfileSlot() >= 0){
+                p->setProfileSlot(m_profiles.find(p->getName()));
+            }
+        }
+    }
+    //Writes every profiled player's money and record back to the store.
+    void saveProfiles(){
+        if (!m_profiles.isOpen()){
+            return;
+        }
+        for (auto& p : m_players){
+            if (p->getProfileSlot() >= 0){
+                const string& name = p->getName();
+                m_profiles.update(p->getProfileSlot(), p->getMoney(), m_stats.getWins(name), m_stats.getLosses(name));
+            }
+        }
+        m_profiles.flush();
+    }
+    //Starts writing the action log out to path in the background.
+    bool startActionLogWriter(const string& path){
+        return m_actionLog.startWriter(path);
+    }
+    void displayActionLog() const{
+        cout << "\n===== ACTION LOG =====\n";
+
+        if (m_actionLog.hasWriter()){
+            cout << "Actions are being written to " << m_actionLog.getPath() << ".\n";
+            return ;
+        }
+        if (m_actionLog.size() == 0){
+            cout << "No actions currently logged.\n";
+            return ;
+        }
+        m_actionLog.forEach([this](const LogEvent& e){
+            cout << m_actionLog.format(e) << endl;
+        });
+    }
+    void queueEvent(const string& event, int priority){
+        m_events.push(make_pair(priority, event));
+    }
+    void processEvents(){
+        while (!m_events.empty()){
+            cout << "EVENT: " << m_events.top().second << endl;
+            m_events.pop();
+        }
+    }
+    
+    // Menu system
+    void displayMenu() const{
+        cout << "\n=====MENU=====\n";
+        cout << "\n1. Play Game\n";
+        cout << "\n2. Create Player Profile\n";
+        cout << "\n3. Load Player Profile\n";
+        cout << "\n4. View Stats\n";
+        cout << "\n5. View High Scores\n";
+        cout << "\n6. Add Bot Player\n";
+        cout << "\n7. View Action Log\n";
+        cout << "\n8. Quit Game\n";
+    }
+    void showWelcomeScreen() const{
+        cout << "\n=====WELCOME TO BLACKJACK! WITH FRIENDS=====\n";
+        cout << "\n=====Your goal as the player is to try and beat the dealer by getting as close to 21 without going over!\n";
+        cout << "\n=====Each player starts with two cards. The dealer's first card is hidden.\n";
+        cout << "\n=====Each player also must decide to hit (take another card), or stand (stop taking cards).\n";
+        cout << "\n=====The dealer will play against you! With some mental math and a little bit of luck, you could get rich!\n";
+        cout << "\n=====To get started, each of you must create a player profile with your name!\n";
+        cout << "\n=====Good luck, and have fun!\n" << endl;
+    }
+    void createPlayerProfile(){
+        string newName = "";
+        int nMoney = 1000;
+
+        cout << "Enter your name:";
+        cin.ignore(numeric_limits<streamsize>::max(), '\n');
+        getline(cin, newName);
+
+        auto alrExist = find_if(m_players.begin(), m_players.end(), [&newName](const unique_ptr<Player>&p){
+            return p->getName() == newName;
+        });  
+
+        if (alrExist != m_players.end() || m_profiles.find(newName) >= 0){
+            cout << "Player already exists." << endl;
+            return;
+        }
+
+        long long slot = -1;
+        if (m_profiles.isOpen()){
+            slot = m_profiles.insert(newName, nMoney);
+            if (slot < 0){
+                cout << "Couldn't save that profile, names need 1 to " << ProfileRecord::MAXNAME << " characters." << endl;
+                return;
+            }
+            refreshProfileSlots();
+        }
+
+        cout << "\nCreating new profile for " << newName << " with $ " << nMoney << " to start with." << endl;
+
+        auto nP = make_unique<Player>(newName, nMoney);
+        nP->setProfileSlot(slot);
+        addPlayer(move(nP));
+        
+        cout << "\nPlayer profile created successfully!\n" << endl;
+    }
+    
+    //Seats a basic strategy bot with the usual starting money, it plays its turns on its own.
+    void addBotPlayer(){
+        string botName = "Bot " + to_string(m_nextSeat + 1);
+        addPlayer(make_unique<BotPlayer>(botName));
+        cout << "\n" << botName << " takes a seat at the table.\n" << endl;
+    }
+    
+    void loadPlayerProfile(){
+        string pName;
+
+        cout << "Enter your profile name: ";
+        cin.ignore(numeric_limits<streamsize>::max(), '\n');
+        getline(cin, pName);
+
+        auto alrExists = find_if(m_players.begin(), m_players.end(), [&pName](const unique_ptr<Player>& p) {
+             return p->getName() == pName; 
+        });
+
+        //Not at the table yet, but saved from an earlier game, so sit them back down.
+        long long slot = m_profiles.find(pName);
+        if (alrExists == m_players.end() && slot >= 0) {
+            const ProfileRecord& saved = m_profiles.at(slot);
+            int money = static_cast<int>(saved.money);
+            if (money <= 0){
+                money = 1000;
+                cout << "You were out of money last time, here's a fresh $" << money << ".\n";
+            }
+
+            auto loaded = make_unique<Player>(pName, money);
+            loaded->setProfileSlot(slot);
+            addPlayer(move(loaded));
+            m_stats.setRecord(pName, static_cast<int>(saved.wins), static_cast<int>(saved.losses));
+            m_stats.updateHighScore(pName, money);
+            alrExists = m_players.end() - 1;
+        }
+
+        if (alrExists != m_players.end()) {
+        cout << "Welcome back, " << pName << "!\n";
+        cout << "Current balance: $" << (*alrExists)->getMoney() << "\n";
+        
+        // Display player stats
+        cout << "Wins: " << m_stats.getWins(pName) << "\n";
+        cout << "Losses: " << m_stats.getLosses(pName) << "\n";
+        cout << "Win rate: " << fixed << setprecision(1) << (m_stats.getWinRate(pName) * 100) << "%\n";
+        if (m_stats.getRank(pName) > 0){
+            cout << "Leaderboard rank: #" << m_stats.getRank(pName) << " of " << m_stats.getRankedPlayers() << "\n";
+        }
+        } else {
+            cout << "Player profile not found. Create a new profile? (y/n): ";
+            char choice;
+            cin >> choice;
+            cin.ignore(numeric_limits<streamsize>::max(), '\n');
+        
+            if (choice == 'y' || choice == 'Y') {
+            createPlayerProfile();
+            }
+        }
+    }
+};
+
+
+/*
+    how bankrolls fared over many sessions: how often a seat went broke and how fast, what it walked away
+    with, and the worst drawdown (biggest drop from its high point) each seat saw along the way. one
+    entry per seat per session, mergeable across simulation workers like GameStats, and the same size
+    after a billion sessions as after one.
+*/
+class BankrollStats {
+private:
+    long long m_sessions;
+    long long m_ruined;
+    long long m_roundsToRuin; // summed over the ruined ones
+    RunningStats m_finalMoney;
+    QuantileSketch m_drawdowns;
+
+public:
+    BankrollStats() : m_sessions(0), m_ruined(0), m_roundsToRuin(0){}
+
+    //Ruined seats finish with nothing, rounds is how many they lasted.
+    void recordSession(int finalMoney, int maxDrawdown, bool ruined, long long rounds){
+        m_sessions++;
+        m_finalMoney.add(finalMoney);
+        m_drawdowns.add(maxDrawdown);
+        if (ruined){
+            m_ruined++;
+            m_roundsToRuin += rounds;
+        }
+    }
+    void merge(const BankrollStats& other){
+        m_sessions += other.m_sessions;
+        m_ruined += other.m_ruined;
+        m_roundsToRuin += other.m_roundsToRuin;
+        m_finalMoney.merge(other.m_finalMoney);
+        m_drawdowns.merge(other.m_drawdowns);
+    }
+
+    long long getSessions() const{
+        return m_sessions;
+    }
+    double riskOfRuin() const{
+        return m_sessions ? static_cast<double>(m_ruined) / m_sessions : 0.0;
+    }
+    //Half width of the 95% interval on riskOfRuin(), normal approximation.
+    double riskOfRuinMargin() const{
+        double p = riskOfRuin();
+        return m_sessions ? 1.96 * sqrt(p * (1.0 - p) / m_sessions) : 0.0;
+    }
+    double meanRoundsToRuin() const{
+        return m_ruined ? static_cast<double>(m_roundsToRuin) / m_ruined : 0.0;
+    }
+    const RunningStats& getFinalMoney() const{
+        return m_finalMoney;
+    }
+    //The q quantile (0-1) of the per session max drawdowns, to within 1%.
+    double drawdownQuantile(double q) const{
+        return m_drawdowns.quantile(q);
+    }
+
+    void report(int bankroll) const{
+        cout << "Sessions:       " << m_sessions << " seat sessions, $" << bankroll << " bankroll each\n";
+        cout << "Risk of ruin:   " << fixed << setprecision(3) << riskOfRuin() * 100.0 << "% (+/- "
+             << riskOfRuinMargin() * 100.0 << "%)\n";
+        if (m_ruined){
+            cout << "Rounds to ruin: " << fixed << setprecision(1) << meanRoundsToRuin() << " on average\n";
+        }
+        cout << "Final bankroll: $" << fixed << setprecision(2) << m_finalMoney.mean() << " +/- $"
+             << m_finalMoney.margin95() << " on average\n";
+        cout << "Max drawdown:   $" << setprecision(0) << drawdownQuantile(0.5) << " median, $" << drawdownQuantile(0.95)
+             << " at p95, $" << drawdownQuantile(1.0) << " worst\n";
+    }
+};
+
+
+/*
+    Simulator runs headless Games with tables of basic strategy BotPlayers for a fixed number of rounds,
+    then reports throughput and the house edge. nothing here waits on cin, so it can run unattended.
+
+    with sessions set, the table instead plays that many sessions of up to the given number of rounds,
+    every seat starting each one fresh on the bankroll and betting by the bet policy. seats that go broke
+    are dropped by Game::cleanup() like at any other table, and BankrollStats keeps score.
+
+    with more than one thread, every worker gets its own Game (and so its own Dealer and Deck)
+    seeded from the same base seed on its own stream. workers never share anything while playing,
+    their GameStats are merged in worker order once everyone is done.
+*/
+class Simulator {
+private:
+    long long m_rounds;
+    int m_numPlayers;
+    int m_bankroll;
+    int m_flatBet;
+    int m_threads;
+    uint64_t m_seed;
+    TableRules m_rules;
+    double m_penetration;
+    string m_logPath;
+    string m_recordPath;
+    string m_historyPath;
+    long long m_sessions; // 0 plays one long session on the bankroll
+    string m_policySpec; // empty bets flat
+    const CountSystem* m_countSystem;
+
+    GameStats m_results;
+    BankrollStats m_bankrolls;
+    long long m_roundsPlayed;
+    double m_seconds;
+    //Filled in by index from the worker threads, then merged into m_bankrolls.
+    mutable vector<BankrollStats> m_workerBankrolls;
+#ifdef BLKJCK_INSTRUMENT
+    //Filled in by index from the worker threads, then merged into m_metrics.
+    mutable vector<TableMetrics> m_workerMetrics;
+    TableMetrics m_metrics;
+#endif
+
+    void seatBots(Game& table) const{
+        for (int i = 1; i <= m_numPlayers; i++){
+            unique_ptr<BetPolicy> policy = m_policySpec.empty() ? nullptr : makeBetPolicy(m_policySpec, m_flatBet);
+            table.addPlayer(make_unique<BotPlayer>("Bot " + to_string(i), m_bankroll, m_flatBet, move(policy)));
+        }
+    }
+
+    /*
+        one session at a table that's already set up: fresh bots in seats 0 and up, played until the
+        rounds run out or everyone's broke. the shoe carries on from the last session, which is what a
+        player sitting down at a real table gets too.
+    */
+    long long playSession(Game& table, BankrollStats& bankrolls) const{
+        table.m_nextSeat = 0;
+        seatBots(table);
+        vector<int> peak(m_numPlayers, m_bankroll);
+        vector<int> drawdown(m_numPlayers, 0);
+        vector<long long> lasted(m_numPlayers, 0);
+
+        long long played = 0;
+        while (played < m_rounds && !table.m_players.empty()){
+            table.playRound();
+            played++;
+            for (const auto& p : table.m_players){
+                int seat = p->getSeat();
+                peak[seat] = max(peak[seat], p->getMoney());
+                drawdown[seat] = max(drawdown[seat], peak[seat] - p->getMoney());
+                lasted[seat] = played;
+            }
+        }
+
+        for (int seat = 0; seat < m_numPlayers; seat++){
+            Player* p = table.playerAt(seat);
+            if (p){
+                bankrolls.recordSession(p->getMoney(), drawdown[seat], false, played);
+                table.removePlayer(p->getName());
+            }
+            else{
+                //Cleanup() took them off the round after their last one, broke.
+                bankrolls.recordSession(0, peak[seat], true, lasted[seat] + 1);
+            }
+        }
+        return played;
+    }
+
+    //Plays one worker's share of the rounds (or sessions) on its own table, returns how many rounds actually got played.
+    long long runWorker(int worker, long long share, GameStats& out) const{
+        Game table;
+        table.setHeadless(true);
+        table.configureShoe(m_rules.numDecks, m_penetration);
+        table.setRules(m_rules);
+        table.seed(m_seed, static_cast<uint32_t>(worker));
+        if (m_countSystem){
+            table.setCountSystem(*m_countSystem);
+        }
+        if (!m_sessions){
+            seatBots(table);
+        }
+        if (!m_logPath.empty()){
+            table.startActionLogWriter(m_threads == 1 ? m_logPath : m_logPath + "." + to_string(worker));
+        }
+        if (!m_recordPath.empty()){
+            table.startRecording(m_threads == 1 ? m_recordPath : m_recordPath + "." + to_string(worker));
+        }
+        if (!m_historyPath.empty()){
+            table.startHandHistory(m_threads == 1 ? m_historyPath : m_historyPath + "." + to_string(worker));
+        }
+        table.shuffle();
+
+        long long played = 0;
+        if (m_sessions){
+            for (long long session = 0; session < share; session++){
+                played += playSession(table, m_workerBankrolls[worker]);
+            }
+        }
+        else{
+            while (played < share && !table.m_players.empty()){
+                table.playRound();
+                played++;
+            }
+        }
+
+        out = table.m_stats;
+        table.stopHandHistory();
+#ifdef BLKJCK_INSTRUMENT
+        m_workerMetrics[worker] = table.m_metrics;
+#endif
+        return played;
+    }
+
+public:
+    Simulator(long long rounds, int numPlayers = 1, int flatBet = 10, int threads = 1,
+              uint64_t seedValue = random_device{}(), const TableRules& rules = TableRules(), double penetration = DEFAULTPENETRATION,
+              int bankroll = 1000000000)
+        : m_rounds(rounds), m_numPlayers(numPlayers), m_bankroll(bankroll), m_flatBet(flatBet),
+          m_threads(max(threads, 1)), m_seed(seedValue), m_rules(rules), m_penetration(penetration),
+          m_sessions(0), m_countSystem(nullptr), m_roundsPlayed(0), m_seconds(0.0){}
+
+    void run(){
+        vector<GameStats> workerStats(m_threads);
+        vector<long long> workerRounds(m_threads, 0);
+        m_workerBankrolls.assign(m_threads, BankrollStats());
+#ifdef BLKJCK_INSTRUMENT
+        m_workerMetrics.assign(m_threads, TableMetrics());
+#endif
+
+        auto start = chrono::steady_clock::now();
+        long long work = m_sessions ? m_sessions : m_rounds;
+        if (m_threads == 1){
+            workerRounds[0] = runWorker(0, work, workerStats[0]);
+        }
+        else{
+            //Rounds (or sessions) are split up front, so which worker plays what never depends on timing.
+            vector<thread> pool;
+            for (int w = 0; w < m_threads; w++){
+                long long share = work / m_threads + (w < work % m_threads ? 1 : 0);
+                pool.emplace_back([this, w, share, &workerStats, &workerRounds](){
+                    workerRounds[w] = runWorker(w, share, workerStats[w]);
+                });
+            }
+            for (auto& t : pool){
+                t.join();
+            }
+        }
+        auto stop = chrono::steady_clock::now();
+
+        m_seconds = chrono::duration<double>(stop - start).count();
+        m_results = GameStats();
+        m_roundsPlayed = 0;
+        m_bankrolls = BankrollStats();
+        for (int w = 0; w < m_threads; w++){
+            m_results.merge(workerStats[w]);
+            m_bankrolls.merge(m_workerBankrolls[w]);
+            m_roundsPlayed += workerRounds[w];
+        }
+        m_workerBankrolls.clear();
+#ifdef BLKJCK_INSTRUMENT
+        m_metrics = TableMetrics();
+        for (const TableMetrics& metrics : m_workerMetrics){
+            m_metrics.merge(metrics);
+        }
+#endif
+    }
+
+    const GameStats& getResults() const{
+        return m_results;
+    }
+    const BankrollStats& getBankrolls() const{
+        return m_bankrolls;
+    }
+    //Plays sessions of up to the simulator's rounds each instead of one long one.
+    void setSessions(long long sessions){
+        m_sessions = max(sessions, 0LL);
+    }
+    //Every bot bets by makeBetPolicy(spec), with the flat bet as its unit.
+    void setBetPolicy(const string& spec){
+        m_policySpec = spec;
+    }
+    void setCountSystem(const CountSystem& system){
+        m_countSystem = &system;
+    }
+#ifdef BLKJCK_INSTRUMENT
+    const TableMetrics& getMetrics() const{
+        return m_metrics;
+    }
+#endif
+    //Writes every worker's action log out to path (path.N per worker when there's more than one).
+    void setLogPath(const string& path){
+        m_logPath = path;
+    }
+    //Records a replay of every worker's table to path (path.N per worker when there's more than one).
+    void setRecordPath(const string& path){
+        m_recordPath = path;
+    }
+    //Exports every worker's hands to path as a hand history (path.N per worker when there's more than one).
+    void setHistoryPath(const string& path){
+        m_historyPath = path;
+    }
+
+    void report() const{
+        long long hands = m_results.getHandsPlayed();
+        double handsPerSecond = m_seconds > 0.0 ? hands / m_seconds : 0.0;
+
+        cout << "\n===== SIMULATION RESULTS =====\n";
+        cout << "Seed:           " << m_seed << endl;
+        cout << "Threads:        " << m_threads << endl;
+        cout << "Shoe:           " << m_rules.numDecks << " deck(s), " << fixed << setprecision(0)
+             << m_penetration * 100.0 << "% penetration\n";
+        cout << "Rules:          " << m_rules.describe() << endl;
+        if (!m_policySpec.empty()){
+            cout << "Bet policy:     " << m_policySpec << ", $" << m_flatBet << " unit, "
+                 << (m_countSystem ? m_countSystem->name : counts::HILO.name) << " count\n";
+        }
+        if (m_sessions){
+            cout << "Rounds played:  " << m_roundsPlayed << " over " << m_sessions << " sessions of up to " << m_rounds << endl;
+        }
+        else{
+            cout << "Rounds played:  " << m_roundsPlayed << " of " << m_rounds << endl;
+        }
+        cout << "Hands played:   " << hands << endl;
+        cout << "Elapsed:        " << fixed << setprecision(3) << m_seconds << " s\n";
+        cout << "Hands/second:   " << fixed << setprecision(0) << handsPerSecond << endl;
+        cout << "Total wagered:  $" << m_results.getTotalWagered() << endl;
+        cout << "Players net:    $" << m_results.getTotalNet() << endl;
+        cout << "House edge:     " << fixed << setprecision(3) << m_results.getHouseEdge() * 100.0 << "% +/- "
+             << m_results.getHouseEdgeMargin() * 100.0 << "% (95%)\n";
+        const RunningStats& perHand = m_results.getHandNet();
+        cout << "Per hand:       $" << fixed << setprecision(3) << perHand.mean() << " +/- $" << perHand.margin95()
+             << ", std dev $" << perHand.stddev() << endl;
+
+        cout << setw(8) << left << "\nSeat"
+             << setw(14) << right << "Wins"
+             << setw(14) << "Losses"
+             << setw(14) << "Pushes"
+             << setw(16) << "Net" << endl;
+        const vector<SeatRecord>& seats = m_results.getSeatStats();
+        for (size_t i = 0; i < seats.size(); i++){
+            cout << setw(7) << left << i + 1
+                 << setw(14) << right << seats[i].wins
+                 << setw(14) << seats[i].losses
+                 << setw(14) << seats[i].pushes
+                 << setw(16) << seats[i].net << endl;
+        }
+
+        cout << setw(8) << left << "\nUpcard"
+             << setw(14) << right << "Hands"
+             << setw(14) << "Wins"
+             << setw(14) << "Losses"
+             << setw(14) << "Pushes"
+             << setw(16) << "Player edge" << endl;
+        const array<SeatRecord, NUMUPCARDS>& upcards = m_results.getUpcardStats();
+        for (int i = 0; i < NUMUPCARDS; i++){
+            const SeatRecord& up = upcards[i];
+            double edge = up.wagered ? static_cast<double>(up.net) / up.wagered * 100.0 : 0.0;
+            cout << setw(7) << left << (i == NUMUPCARDS - 1 ? string("A") : to_string(i + 2))
+                 << setw(14) << right << up.wins + up.losses + up.pushes
+                 << setw(14) << up.wins
+                 << setw(14) << up.losses
+                 << setw(14) << up.pushes
+                 << setw(15) << fixed << setprecision(2) << edge << "%" << endl;
+        }
+
+        if (m_sessions){
+            cout << "\n===== BANKROLL =====\n";
+            m_bankrolls.report(m_bankroll);
+            const QuantileSketch& seats = m_results.getBankrolls();
+            cout << "Seat bankrolls: $" << fixed << setprecision(0) << seats.quantile(0.05) << " p5, $" << seats.quantile(0.5)
+                 << " median, $" << seats.quantile(0.95) << " p95 after a round\n";
+        }
+    }
+};
+
+
+/*
+    SessionReplay plays a file written by ReplayRecorder back into a fresh headless Game. people's bets
+    and decisions come out of the file through the same submitBet()/submitAction() calls the terminal and
+    the server use, everything else the table works out again from the seed. at the END event the money
+    everyone finished with has to match what was recorded.
+*/
+class SessionReplay {
+private:
+    static const uint64_t MAXNAME = 4096; // anything longer is a corrupt file, not a name
+
+    ifstream m_in;
+    string m_path;
+    long long m_rounds;
+    long long m_inputs;
+    bool m_verified;
+    bool m_matches;
+    string m_error;
+    double m_seconds;
+
+    bool getVarint(uint64_t& value){
+        value = 0;
+        for (int shift = 0; shift < 64; shift += 7){
+            int byte = m_in.get();
+            if (byte == EOF){
+                return false;
+            }
+            value |= static_cast<uint64_t>(byte & 0x7F) << shift;
+            if (!(byte & 0x80)){
+                return true;
+            }
+        }
+        return false;
+    }
+    bool getSigned(int64_t& value){
+        uint64_t raw;
+        if (!getVarint(raw)){
+            return false;
+        }
+        value = static_cast<int64_t>(raw >> 1) ^ -static_cast<int64_t>(raw & 1);
+        return true;
+    }
+    bool fail(const string& why){
+        m_error = why;
+        return false;
+    }
+    bool getString(string& text){
+        uint64_t size;
+        if (!getVarint(size) || size > MAXNAME){
+            return false;
+        }
+        text.assign(size, '\0');
+        m_in.read(&text[0], static_cast<streamsize>(size));
+        return static_cast<bool>(m_in);
+    }
+    //Applies one event to the table, false if the file is cut short or the table won't take it.
+    bool apply(ReplayEventType type, Game& game){
+        uint64_t seat = 0;
+        uint64_t value = 0;
+        int64_t amount = 0;
+
+        switch (type){
+            case ReplayEventType::SEED:
+                if (!getVarint(value) || !getVarint(seat)){
+                    return fail("truncated SEED");
+                }
+                game.seed(value, static_cast<uint32_t>(seat));
+                return true;
+            case ReplayEventType::SHOE:{
+                double penetration;
+                if (!getVarint(seat) || !getVarint(value)){
+                    return fail("truncated SHOE");
+                }
+                memcpy(&penetration, &value, sizeof(penetration));
+                game.configureShoe(static_cast<int>(seat), penetration);
+                return true;
+            }
+            case ReplayEventType::JOIN:{
+                int64_t flatBet;
+                string name;
+                if (!getVarint(seat) || !getString(name) || !getSigned(amount) || !getSigned(flatBet)){
+                    return fail("bad JOIN");
+                }
+                //Seats come back with the numbers they had, so later events still point at the right player.
+                game.m_nextSeat = static_cast<int>(seat);
+                if (flatBet > 0){
+                    game.addPlayer(make_unique<BotPlayer>(name, static_cast<int>(amount), static_cast<int>(flatBet)));
+                }
+                else{
+                    game.addPlayer(make_unique<Player>(name, static_cast<int>(amount)));
+                }
+                return true;
+            }
+            case ReplayEventType::LEAVE:{
+                if (!getVarint(seat)){
+                    return fail("truncated LEAVE");
+                }
+                Player* p = game.playerAt(static_cast<int>(seat));
+                if (p){
+                    game.removePlayer(p->getName());
+                }
+                return true;
+            }
+            case ReplayEventType::SHUFFLE:
+                game.shuffle();
+                return true;
+            case ReplayEventType::ROUNDS:
+                if (!getVarint(value)){
+                    return fail("truncated ROUNDS");
+                }
+                for (uint64_t r = 0; r < value; r++){
+                    game.beginRound();
+                }
+                m_rounds += static_cast<long long>(value);
+                return true;
+            case ReplayEventType::BET:
+                if (!getVarint(seat) || !getSigned(amount)){
+                    return fail("truncated BET");
+                }
+                m_inputs++;
+                return game.submitBet(static_cast<int>(seat), static_cast<int>(amount)) || fail("table refused a recorded bet");
+            case ReplayEventType::INSURANCE:
+                if (!getVarint(seat) || !getVarint(value)){
+                    return fail("truncated INSURANCE");
+                }
+                m_inputs++;
+                return game.submitInsurance(static_cast<int>(seat), value != 0) || fail("table refused a recorded insurance answer");
+            case ReplayEventType::ACTION:
+                if (!getVarint(seat) || !getVarint(value) || value > static_cast<uint64_t>(Action::SURRENDER)){
+                    return fail("bad ACTION");
+                }
+                m_inputs++;
+                return game.submitAction(static_cast<int>(seat), static_cast<Action>(value)) || fail("table refused a recorded decision");
+            case ReplayEventType::FORFEIT:
+                if (!getVarint(seat)){
+                    return fail("truncated FORFEIT");
+                }
+                return game.forfeitSeat(static_cast<int>(seat)) || fail("table refused a recorded forfeit");
+            case ReplayEventType::END:
+                return verify(game);
+            case ReplayEventType::RULES:{
+                uint64_t fields[6];
+                for (uint64_t& field : fields){
+                    if (!getVarint(field)){
+                        return fail("truncated RULES");
+                    }
+                }
+                if (fields[1] > static_cast<uint64_t>(BlackjackPayout::EVEN_MONEY) || fields[2] > static_cast<uint64_t>(DoubleRule::TEN_OR_ELEVEN)
+                    || fields[4] < 1 || fields[4] > static_cast<uint64_t>(MAXHANDS)){
+                    return fail("bad RULES");
+                }
+                TableRules rules = game.getRules();
+                rules.hitSoft17 = fields[0] != 0;
+                rules.blackjackPays = static_cast<BlackjackPayout>(fields[1]);
+                rules.doubleOn = static_cast<DoubleRule>(fields[2]);
+                rules.doubleAfterSplit = fields[3] != 0;
+                rules.maxHands = static_cast<int>(fields[4]);
+                rules.lateSurrender = fields[5] != 0;
+                game.setRules(rules);
+                return true;
+            }
+            case ReplayEventType::COUNT:{
+                string name;
+                if (!getString(name)){
+                    return fail("truncated COUNT");
+                }
+                const CountSystem* system = counts::find(name);
+                if (!system){
+                    return fail("unknown count system " + name);
+                }
+                game.setCountSystem(*system);
+                return true;
+            }
+            case ReplayEventType::POLICY:{
+                string spec;
+                uint64_t lastBet;
+                int64_t lastNet;
+                if (!getVarint(seat) || !getString(spec) || !getVarint(lastBet) || !getSigned(lastNet)){
+                    return fail("truncated POLICY");
+                }
+                BotPlayer* bot = dynamic_cast<BotPlayer*>(game.playerAt(static_cast<int>(seat)));
+                unique_ptr<BetPolicy> policy = makeBetPolicy(spec, bot ? bot->getFlatBet() : 0);
+                if (!bot || !policy){
+                    return fail("bad POLICY");
+                }
+                bot->setBetPolicy(move(policy));
+                bot->resumeBetting(static_cast<int>(lastBet), static_cast<int>(lastNet));
+                return true;
+            }
+        }
+        return fail("unknown event " + to_string(static_cast<int>(type)));
+    }
+    bool verify(Game& game){
+        uint64_t players;
+        if (!getVarint(players)){
+            return fail("truncated END");
+        }
+        m_verified = true;
+        m_matches = (players == game.m_players.size());
+        for (uint64_t i = 0; i < players; i++){
+            uint64_t seat;
+            int64_t money;
+            if (!getVarint(seat) || !getSigned(money)){
+                return fail("truncated END");
+            }
+            Player* p = game.playerAt(static_cast<int>(seat));
+            if (!p || p->getMoney() != money){
+                m_matches = false;
+            }
+        }
+        return true;
+    }
+
+public:
+    SessionReplay() : m_rounds(0), m_inputs(0), m_verified(false), m_matches(false), m_seconds(0.0){}
+
+    bool open(const string& path){
+        m_path = path;
+        m_in.open(path, ios::binary);
+        char magic[sizeof(REPLAYMAGIC)];
+        if (!m_in.read(magic, sizeof(magic)) || memcmp(magic, REPLAYMAGIC, sizeof(magic)) != 0){
+            return fail("not a replay file");
+        }
+        return true;
+    }
+    //Plays the whole file into game, false if it stopped early (error() says why).
+    bool run(Game& game){
+        game.setHeadless(true);
+        auto start = chrono::steady_clock::now();
+
+        bool ok = true;
+        int type;
+        while (ok && !m_verified && (type = m_in.get()) != EOF){
+            ok = apply(static_cast<ReplayEventType>(type), game);
+        }
+
+        m_seconds = chrono::duration<double>(chrono::steady_clock::now() - start).count();
+        return ok;
+    }
+    const string& error() const{
+        return m_error;
+    }
+    bool verified() const{
+        return m_verified;
+    }
+    //True when the file had an END and the table finished exactly where the recording did.
+    bool matches() const{
+        return m_verified && m_matches;
+    }
+
+    void report(const Game& game) const{
+        cout << "\n===== REPLAY =====\n";
+        cout << "File:           " << m_path << endl;
+        cout << "Rounds:         " << m_rounds << endl;
+        cout << "Hands played:   " << game.m_stats.getHandsPlayed() << endl;
+        cout << "Recorded input: " << m_inputs << " bets and decisions\n";
+        cout << "Players net:    $" << game.m_stats.getTotalNet() << endl;
+        cout << "Elapsed:        " << fixed << setprecision(3) << m_seconds << " s\n";
+        for (const auto& p : game.m_players){
+            cout << "  " << p->getName() << ": $" << p->getMoney() << endl;
+        }
+        if (!m_error.empty()){
+            cout << "Stopped early:  " << m_error << endl;
+        }
+        else if (!m_verified){
+            cout << "Result:         no END in the file, nothing to check against\n";
+        }
+        else{
+            cout << "Result:         " << (m_matches ? "matches the recording" : "DIFFERS from the recording") << endl;
+        }
+    }
+};
+
+
+/*
+    TableScheduler runs the clock for a set of Game tables all driven from one thread. nothing in here
+    ever blocks on a player: tables are stepped by whoever owns the input (submitBet()/submitAction() on
+    the Game), and track() is called after every step to see what the table wants next.
+
+    a table waiting on a seat gets a deadline in one min-heap shared by every table, so a single
+    nextTimeoutMs() tells the owner how long it may sleep. tables that finished their players' turns
+    are parked and queued instead of playing the dealer straight away, playDealers() then runs every
+    queued dealer in one pass.
+*/
+class TableScheduler {
+private:
+    struct Deadline {
+        chrono::steady_clock::time_point when;
+        int table;
+        int seat;
+        uint64_t token;
+
+        bool operator>(const Deadline& other) const{
+            return when > other.when;
+        }
+    };
+
+    vector<unique_ptr<Game>> m_tables;
+    vector<uint64_t> m_waitTokens; // bumped every time a table moves on, older deadlines are stale
+    vector<bool> m_dealerQueued;
+    vector<int> m_dealerQueue;
+    vector<int> m_dealerBatch;
+    priority_queue<Deadline, vector<Deadline>, greater<Deadline>> m_deadlines;
+    chrono::milliseconds m_timeout;
+
+public:
+    explicit TableScheduler(int timeoutMs = 30000) : m_timeout(timeoutMs){}
+
+    int addTable(unique_ptr<Game> game){
+        game->setBatchDealer(true);
+        m_tables.push_back(move(game));
+        m_waitTokens.push_back(0);
+        m_dealerQueued.push_back(false);
+        return static_cast<int>(m_tables.size()) - 1;
+    }
+    Game& table(int t){
+        return *m_tables[t];
+    }
+    size_t size() const{
+        return m_tables.size();
+    }
+
+    /*
+        call after anything happens at table t. starts the clock on the seat it's waiting on now (and
+        returns that seat), or queues its dealer for the next playDealers() and returns -1.
+    */
+    int track(int t){
+        Game& game = *m_tables[t];
+        m_waitTokens[t]++;
+        if (game.awaitingDealer()){
+            if (!m_dealerQueued[t]){
+                m_dealerQueued[t] = true;
+                m_dealerQueue.push_back(t);
+            }
+            return -1;
+        }
+        int seat = game.waitingSeat();
+        if (seat >= 0){
+            m_deadlines.push(Deadline{chrono::steady_clock::now() + m_timeout, t, seat, m_waitTokens[t]});
+        }
+        return seat;
+    }
+
+    //Calls expired(table, seat) for every seat whose deadline has passed while its table was still waiting on it.
+    template <class Callback>
+    void expire(Callback expired){
+        auto now = chrono::steady_clock::now();
+        while (!m_deadlines.empty() && m_deadlines.top().when <= now){
+            Deadline due = m_deadlines.top();
+            m_deadlines.pop();
+            if (due.token == m_waitTokens[due.table] && m_tables[due.table]->waitingSeat() == due.seat){
+                expired(due.table, due.seat);
+            }
+        }
+    }
+
+    //Plays every queued dealer back to back, then calls done(table) for each so its owner can carry on.
+    template <class Callback>
+    void playDealers(Callback done){
+        swap(m_dealerBatch, m_dealerQueue);
+        for (int t : m_dealerBatch){
+            m_dealerQueued[t] = false;
+            m_tables[t]->playDealer();
+        }
+        for (int t : m_dealerBatch){
+            done(t);
+        }
+        m_dealerBatch.clear();
+    }
+    bool hasDealersQueued() const{
+        return !m_dealerQueue.empty();
+    }
+
+    //How long the owner can sleep before a deadline is due, -1 for as long as it likes.
+    int nextTimeoutMs() const{
+        if (!m_dealerQueue.empty()){
+            return 0;
+        }
+        if (m_deadlines.empty()){
+            return -1;
+        }
+        auto wait = chrono::duration_cast<chrono::milliseconds>(m_deadlines.top().when - chrono::steady_clock::now()).count();
+        return static_cast<int>(max<long long>(wait + 1, 0));
+    }
+};
+
+
+#ifdef BLKJCK_HAVE_EPOLL
+/*
+    TableServer hosts any number of Game tables for players connecting over TCP. one thread runs the lot
+    off a single epoll loop. sockets are non-blocking and a connection is just its fd and a couple of small
+    buffers, so thousands of idle ones cost next to nothing.
+
+    the protocol is plain lines of text, nc or telnet is enough of a client:
+        JOIN <name> [table]   sit down (at the first table with a free seat if no table is given)
+        BET <amount>          answers a YOUR_BET prompt
+        INSURANCE YES|NO      answers a YOUR_INSURANCE prompt
+        HIT, STAND, DOUBLE,
+        SPLIT, SURRENDER      answer a YOUR_TURN prompt, for the hand it names
+        TABLES                lists the tables and how full they are
+        LEAVE                 gets up from the table, QUIT also hangs up
+    the server replies with OK/ERR lines, prompts whichever seat its table is waiting on, and streams
+    every table event out of the action log as EVENT lines.
+
+    the tables themselves live in a TableScheduler, which keeps their deadlines. when a wait runs out
+    the seat stands (declines insurance, or while betting gives up their seat) so one quiet player can't hold up everybody
+    else. dealers are played in a batch once per pass of the loop.
+*/
+class TableServer {
+public:
+    static const int MAXSEATS = 7;
+    static const size_t MAXLINE = 512;
+    static const size_t MAXPENDING = 1 << 16; // unsent output before a connection is written off as dead
+
+private:
+    struct Connection {
+        string in;  // received, not yet a full line
+        string out; // waiting for the socket to take it
+        string name;
+        int table = -1;
+        int seat = -1;
+        bool seated = false; // false while they wait for the current round to finish
+        bool wantsWrite = false;
+        bool closing = false;
+    };
+    //The server's side of a table, the Game itself is in the scheduler under the same index.
+    struct Table {
+        uint64_t logCursor = 0;
+        unordered_map<int, int> seats; // seat -> connection, -1 once they've walked off mid round
+        vector<int> joining; // connections that sit down when the next round starts
+        uint64_t holeRound = 0; // round whose face down card has gone out
+        bool holeHidden = false;
+        Card holeCard;
+    };
+    int m_listenFd;
+    int m_epollFd;
+    TableRules m_rules;
+    double m_penetration;
+    int m_buyIn;
+
+    unordered_map<int, Connection> m_connections;
+    vector<Table> m_tables;
+    TableScheduler m_scheduler;
+    vector<int> m_closing;
+
+    inline static volatile sig_atomic_t s_stop = 0;
+
+    static void onSignal(int){
+        s_stop = 1;
+    }
+
+    void watch(int fd, uint32_t events, int op){
+        epoll_event ev{};
+        ev.events = events;
+        ev.data.fd = fd;
+        epoll_ctl(m_epollFd, op, fd, &ev);
+    }
+
+    //Queues a line for fd and pushes out as much as the socket will take right now.
+    void send(int fd, const string& line){
+        auto found = m_connections.find(fd);
+        if (found == m_connections.end() || found->second.closing){
+            return;
+        }
+        Connection& c = found->second;
+        bool wasIdle = c.out.empty();
+        c.out += line;
+        c.out += '\n';
+        if (c.out.size() > MAXPENDING){
+            hangUp(fd);
+            return;
+        }
+        if (wasIdle){
+            flush(fd);
+        }
+    }
+    void flush(int fd){
+        Connection& c = m_connections[fd];
+        size_t sent = 0;
+        while (sent < c.out.size()){
+            ssize_t n = ::send(fd, c.out.data() + sent, c.out.size() - sent, MSG_NOSIGNAL | MSG_DONTWAIT);
+            if (n > 0){
+                sent += static_cast<size_t>(n);
+            }
+            else if (n < 0 && errno == EINTR){
+                continue;
+            }
+            else if (n < 0 && (errno == EAGAIN || errno == EWOULDBLOCK)){
+                break;
+            }
+            else{
+                hangUp(fd);
+                return;
+            }
+        }
+        c.out.erase(0, sent);
+        //Only ask to hear about writability while there's actually something stuck.
+        bool wantsWrite = !c.out.empty();
+        if (wantsWrite != c.wantsWrite){
+            c.wantsWrite = wantsWrite;
+            watch(fd, wantsWrite ? (EPOLLIN | EPOLLOUT) : EPOLLIN, EPOLL_CTL_MOD);
+        }
+    }
+    //Connections are only ever closed between events, so nothing further up the stack is left holding one.
+    void hangUp(int fd){
+        Connection& c = m_connections[fd];
+        if (!c.closing){
+            c.closing = true;
+            m_closing.push_back(fd);
+        }
+    }
+    void closeConnection(int fd){
+        leaveTable(fd);
+        epoll_ctl(m_epollFd, EPOLL_CTL_DEL, fd, nullptr);
+        ::close(fd);
+        m_connections.erase(fd);
+    }
+
+    void acceptAll(){
+        while (true){
+            int fd = accept4(m_listenFd, nullptr, nullptr, SOCK_NONBLOCK | SOCK_CLOEXEC);
+            if (fd < 0){
+                if (errno == EINTR){
+                    continue;
+                }
+                //EAGAIN means the backlog is empty, anything else (out of fds) gets retried next time round.
+                return;
+            }
+            int on = 1;
+            setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &on, sizeof(on));
+            m_connections[fd];
+            watch(fd, EPOLLIN, EPOLL_CTL_ADD);
+            send(fd, "WELCOME blackjack, JOIN <name> to sit down");
+        }
+    }
+    void readFrom(int fd){
+        char buffer[4096];
+        while (true){
+            ssize_t n = recv(fd, buffer, sizeof(buffer), 0);
+            if (n > 0){
+                m_connections[fd].in.append(buffer, static_cast<size_t>(n));
+                continue;
+            }
+            if (n < 0 && errno == EINTR){
+                continue;
+            }
+            if (n < 0 && (errno == EAGAIN || errno == EWOULDBLOCK)){
+                break;
+            }
+            hangUp(fd);
+            return;
+        }
+
+        Connection& c = m_connections[fd];
+        size_t start = 0;
+        size_t end;
+        while (!c.closing && (end = c.in.find('\n', start)) != string::npos){
+            string line = c.in.substr(start, end - start);
+            if (!line.empty() && line.back() == '\r'){
+                line.pop_back();
+            }
+            start = end + 1;
+            handleLine(fd, line);
+        }
+        c.in.erase(0, start);
+        if (c.in.size() > MAXLINE){
+            send(fd, "ERR line too long");
+            hangUp(fd);
+        }
+    }
+
+    void handleLine(int fd, const string& line){
+        istringstream words(line);
+        string command;
+        words >> command;
+        transform(command.begin(), command.end(), command.begin(), ::toupper);
+        Connection& c = m_connections[fd];
+
+        if (command.empty()){
+            return;
+        }
+        if (command == "JOIN"){
+            string name;
+            int table = -1;
+            words >> name >> table;
+            join(fd, name, table);
+        }
+        else if (command == "BET"){
+            int amount = 0;
+            words >> amount;
+            if (!c.seated || !m_scheduler.table(c.table).submitBet(c.seat, amount)){
+                send(fd, "ERR not your bet, or not a bet you can cover");
+                return;
+            }
+            settle(c.table);
+        }
+        else if (command == "INSURANCE"){
+            string answer;
+            words >> answer;
+            transform(answer.begin(), answer.end(), answer.begin(), ::toupper);
+            if (!c.seated || !m_scheduler.table(c.table).submitInsurance(c.seat, answer == "YES" || answer == "Y")){
+                send(fd, "ERR no insurance on offer to you");
+                return;
+            }
+            settle(c.table);
+        }
+        else if (command == "HIT" || command == "STAND" || command == "DOUBLE" || command == "SPLIT" || command == "SURRENDER"){
+            Action choice = command == "HIT" ? Action::HIT : command == "STAND" ? Action::STAND : command == "DOUBLE" ? Action::DOUBLE
+                          : command == "SPLIT" ? Action::SPLIT : Action::SURRENDER;
+            if (!c.seated || !m_scheduler.table(c.table).submitAction(c.seat, choice)){
+                send(fd, "ERR not your turn, or not allowed on this hand");
+                return;
+            }
+            settle(c.table);
+        }
+        else if (command == "TABLES"){
+            for (size_t t = 0; t < m_tables.size(); t++){
+                send(fd, "TABLE " + to_string(t) + " " + to_string(occupancy(m_tables[t])) + "/" + to_string(MAXSEATS));
+            }
+            send(fd, "OK " + to_string(m_tables.size()) + " tables");
+        }
+        else if (command == "LEAVE"){
+            leaveTable(fd);
+            send(fd, "OK left the table");
+        }
+        else if (command == "QUIT"){
+            send(fd, "OK bye");
+            hangUp(fd);
+        }
+        else{
+            send(fd, "ERR unknown command " + command);
+        }
+    }
+
+    static int occupancy(const Table& table){
+        return static_cast<int>(table.seats.size() + table.joining.size());
+    }
+    bool nameTaken(const Table& table, const string& name) const{
+        for (const auto& entry : table.seats){
+            auto found = m_connections.find(entry.second);
+            if (found != m_connections.end() && found->second.name == name){
+                return true;
+            }
+        }
+        for (int fd : table.joining){
+            if (m_connections.at(fd).name == name){
+                return true;
+            }
+        }
+        return false;
+    }
+    int openTable(){
+        auto game = make_unique<Game>();
+        game->setHeadless(true);
+        game->configureShoe(m_rules.numDecks, m_penetration);
+        game->setRules(m_rules);
+        game->m_dealer.shuffleDeck();
+        m_tables.emplace_back();
+        return m_scheduler.addTable(move(game));
+    }
+
+    void join(int fd, const string& name, int table){
+        Connection& c = m_connections[fd];
+        if (c.table >= 0){
+            send(fd, "ERR already at table " + to_string(c.table));
+            return;
+        }
+        if (name.empty() || name.size() > ProfileRecord::MAXNAME){
+            send(fd, "ERR names need 1 to " + to_string(ProfileRecord::MAXNAME) + " characters");
+            return;
+        }
+        if (table < 0){
+            for (size_t t = 0; t < m_tables.size() && table < 0; t++){
+                if (occupancy(m_tables[t]) < MAXSEATS && !nameTaken(m_tables[t], name)){
+                    table = static_cast<int>(t);
+                }
+            }
+            if (table < 0){
+                table = openTable();
+            }
+        }
+        if (table >= static_cast<int>(m_tables.size())){
+            send(fd, "ERR no table " + to_string(table));
+            return;
+        }
+        if (occupancy(m_tables[table]) >= MAXSEATS || nameTaken(m_tables[table], name)){
+            send(fd, "ERR table " + to_string(table) + " is full or already has a " + name);
+            return;
+        }
+
+        c.name = name;
+        c.table = table;
+        m_tables[table].joining.push_back(fd);
+        send(fd, "OK table " + to_string(table) + ", you'll be dealt in at the next round");
+        if (!m_scheduler.table(table).isRoundActive()){
+            settle(table);
+        }
+    }
+    //Gets a connection up from its table. mid round their bet stays down and the table stands for them.
+    void leaveTable(int fd){
+        Connection& c = m_connections[fd];
+        if (c.table < 0){
+            return;
+        }
+        int t = c.table;
+        Table& table = m_tables[t];
+        if (!c.seated){
+            table.joining.erase(remove(table.joining.begin(), table.joining.end(), fd), table.joining.end());
+        }
+        else{
+            table.seats[c.seat] = -1;
+            Game& game = m_scheduler.table(t);
+            if (!game.isRoundActive()){
+                game.removePlayer(c.name);
+                table.seats.erase(c.seat);
+            }
+            else if (game.waitingSeat() != c.seat && game.forfeitSeat(c.seat)){
+                table.seats.erase(c.seat);
+            }
+        }
+        c.table = -1;
+        c.seat = -1;
+        c.seated = false;
+        settle(t);
+    }
+
+    /*
+        brings a table up to date after anything happened to it: streams out the new events, starts
+        the next round when one finishes, and prompts whoever it's waiting on now. a table that's
+        waiting on its dealer is left for the next batch.
+    */
+    void settle(int t){
+        while (true){
+            broadcast(t);
+            Game& game = m_scheduler.table(t);
+            if (!game.isRoundActive()){
+                if (!startRound(t)){
+                    return;
+                }
+                continue;
+            }
+
+            int seat = m_scheduler.track(t);
+            if (seat < 0){
+                return;
+            }
+            Table& table = m_tables[t];
+            int fd = table.seats.count(seat) ? table.seats[seat] : -1;
+            if (fd < 0){
+                timeOut(t, seat);
+                continue;
+            }
+
+            Player& p = *game.playerAt(seat);
+            if (game.getState() == Game::GameState::BETTING){
+                send(fd, "YOUR_BET money=" + to_string(p.getMoney()));
+            }
+            else if (game.getState() == Game::GameState::INSURANCE){
+                send(fd, "YOUR_INSURANCE cost=" + to_string(p.getBet() / 2));
+            }
+            else{
+                send(fd, "YOUR_TURN total=" + to_string(p.getHand().getTotal()) + " soft=" + to_string(p.getHand().isSoft())
+                         + " up=" + to_string(game.m_dealer.getUpcard().getValue()) + " double=" + to_string(game.canDouble(p))
+                         + " split=" + to_string(game.canSplit(p)) + " surrender=" + to_string(game.canSurrender(p))
+                         + " hand=" + to_string(p.getActiveHand() + 1) + "/" + to_string(p.getNumHands()));
+            }
+            return;
+        }
+    }
+    //Clears out whoever left or went broke, seats the newcomers, then deals the next round if anyone's there.
+    bool startRound(int t){
+        Table& table = m_tables[t];
+        Game& game = m_scheduler.table(t);
+
+        for (auto seat = table.seats.begin(); seat != table.seats.end();){
+            Player* p = game.playerAt(seat->first);
+            if (seat->second < 0 && p){
+                game.removePlayer(p->getName());
+                p = nullptr;
+            }
+            if (!p){
+                //Cleanup already took out anyone who ran out of money.
+                if (seat->second >= 0){
+                    Connection& c = m_connections[seat->second];
+                    c.table = -1;
+                    c.seat = -1;
+                    c.seated = false;
+                    send(seat->second, "OUT out of money, JOIN again to buy back in");
+                }
+                seat = table.seats.erase(seat);
+            }
+            else{
+                seat++;
+            }
+        }
+
+        for (int fd : table.joining){
+            Connection& c = m_connections[fd];
+            game.addPlayer(make_unique<Player>(c.name, m_buyIn));
+            c.seat = game.m_players.back()->getSeat();
+            c.seated = true;
+            table.seats[c.seat] = fd;
+            send(fd, "SEATED table=" + to_string(t) + " seat=" + to_string(c.seat) + " money=" + to_string(m_buyIn));
+        }
+        table.joining.clear();
+
+        if (game.m_players.empty()){
+            broadcast(t);
+            return false;
+        }
+        game.beginRound();
+        return true;
+    }
+    //The table gave up waiting on seat: a bet that never came costs them the seat, insurance is declined, a turn just stands.
+    void timeOut(int t, int seat){
+        Table& table = m_tables[t];
+        Game& game = m_scheduler.table(t);
+        int fd = table.seats.count(seat) ? table.seats[seat] : -1;
+
+        if (game.getState() == Game::GameState::BETTING){
+            game.forfeitSeat(seat);
+            table.seats.erase(seat);
+            if (fd >= 0){
+                Connection& c = m_connections[fd];
+                c.table = -1;
+                c.seat = -1;
+                c.seated = false;
+                send(fd, "TIMEOUT no bet in time, you gave up your seat");
+            }
+        }
+        else if (game.getState() == Game::GameState::INSURANCE){
+            game.submitInsurance(seat, false);
+            if (fd >= 0){
+                send(fd, "TIMEOUT too slow, no insurance for you");
+            }
+        }
+        else{
+            game.submitAction(seat, Action::STAND);
+            if (fd >= 0){
+                send(fd, "TIMEOUT too slow, standing for you");
+            }
+        }
+    }
+    //Sends the table's new events to everyone there. the dealer's face down card stays hidden until they play.
+    void broadcast(int t){
+        Table& table = m_tables[t];
+        const ActionLog& log = m_scheduler.table(t).m_actionLog;
+        log.forEachSince(table.logCursor, [&](const LogEvent& e){
+            if (e.type == LogEventType::DEALT && e.seat == DEALER_SEAT && e.round != table.holeRound){
+                table.holeRound = e.round;
+                table.holeCard = e.card;
+                table.holeHidden = true;
+                tell(table, "EVENT [round " + to_string(e.round) + "] Dealer is dealt a card face down");
+                return;
+            }
+            if (table.holeHidden && revealsHoleCard(e)){
+                table.holeHidden = false;
+                tell(table, "EVENT [round " + to_string(e.round) + "] Dealer turns over " + table.holeCard.getRank()
+                            + " of " + table.holeCard.getSuit());
+            }
+            tell(table, "EVENT " + log.format(e));
+        });
+    }
+    //The dealer playing their hand turns it over, and so does a blackjack found on the peek.
+    static bool revealsHoleCard(const LogEvent& e){
+        LogEventType type = e.type;
+        if (type == LogEventType::BLACKJACK && e.seat == DEALER_SEAT){
+            return true;
+        }
+        return type == LogEventType::ALL_BUSTED || type == LogEventType::DEALER_HIT
+            || type == LogEventType::DEALER_BUSTED || type == LogEventType::DEALER_STOOD;
+    }
+    void tell(const Table& table, const string& line){
+        for (const auto& entry : table.seats){
+            if (entry.second >= 0){
+                send(entry.second, line);
+            }
+        }
+        for (int fd : table.joining){
+            send(fd, line);
+        }
+    }
+
+public:
+    TableServer(const TableRules& rules = TableRules(), double penetration = DEFAULTPENETRATION, int timeoutMs = 30000, int buyIn = 1000)
+        : m_listenFd(-1), m_epollFd(-1), m_rules(rules), m_penetration(penetration), m_buyIn(buyIn), m_scheduler(timeoutMs){}
+    ~TableServer(){
+        for (auto& entry : m_connections){
+            ::close(entry.first);
+        }
+        if (m_listenFd >= 0){
+            ::close(m_listenFd);
+        }
+        if (m_epollFd >= 0){
+            ::close(m_epollFd);
+        }
+    }
+    TableServer(const TableServer&) = delete;
+    TableServer& operator=(const TableServer&) = delete;
+
+    //Binds and starts listening, false (with errno set) if the address can't be used.
+    bool listen(const string& host, int port){
+        sockaddr_in addr{};
+        addr.sin_family = AF_INET;
+        addr.sin_port = htons(static_cast<uint16_t>(port));
+        if (inet_pton(AF_INET, host.c_str(), &addr.sin_addr) != 1){
+            errno = EINVAL;
+            return false;
+        }
+
+        m_listenFd = socket(AF_INET, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+        int on = 1;
+        setsockopt(m_listenFd, SOL_SOCKET, SO_REUSEADDR, &on, sizeof(on));
+        if (m_listenFd < 0 || bind(m_listenFd, reinterpret_cast<sockaddr*>(&addr), sizeof(addr)) < 0
+            || ::listen(m_listenFd, SOMAXCONN) < 0){
+            return false;
+        }
+        m_epollFd = epoll_create1(EPOLL_CLOEXEC);
+        if (m_epollFd < 0){
+            return false;
+        }
+        watch(m_listenFd, EPOLLIN, EPOLL_CTL_ADD);
+        return true;
     }
-    void placeBets(){
-        cout << "\n===== PLACING BETS =====\n";
-        for (auto& p : m_players){
-            int money = p->getMoney();
-            cout << p->getName() << " , you've got $" << money << ". Place your bet: $";
 
-            int bet;
-            cin >> bet;
-            cin.ignore(numeric_limits<streamsize>::max(), '\n');
+    //Serves until SIGINT/SIGTERM.
+    void run(){
+        signal(SIGINT, onSignal);
+        signal(SIGTERM, onSignal);
+        signal(SIGPIPE, SIG_IGN);
 
-            while (!p->placeBet(bet)){
-                cout << "Invalid bet. You only have $" << money << ". Place your bet: $";
-                cin >> bet;
-                cin.ignore(numeric_limits<streamsize>::max(), '\n');
+        array<epoll_event, 256> events;
+        while (!s_stop){
+            int ready = epoll_wait(m_epollFd, events.data(), static_cast<int>(events.size()), m_scheduler.nextTimeoutMs());
+            if (ready < 0 && errno != EINTR){
+                perror("epoll_wait");
+                return;
+            }
+
+            for (int i = 0; i < ready; i++){
+                int fd = events[i].data.fd;
+                if (fd == m_listenFd){
+                    acceptAll();
+                    continue;
+                }
+                auto found = m_connections.find(fd);
+                if (found == m_connections.end() || found->second.closing){
+                    continue;
+                }
+                if (events[i].events & (EPOLLIN | EPOLLHUP | EPOLLERR)){
+                    readFrom(fd);
+                }
+                if ((events[i].events & EPOLLOUT) && !m_connections[fd].closing){
+                    flush(fd);
+                }
             }
+            m_scheduler.expire([this](int t, int seat){
+                timeOut(t, seat);
+                settle(t);
+            });
+            m_scheduler.playDealers([this](int t){
+                settle(t);
+            });
 
-            logAction(p->getName() + " bet $" + to_string(bet));
+            //Closing can wake up a table and queue more closes, so keep going until it settles.
+            while (!m_closing.empty()){
+                int fd = m_closing.back();
+                m_closing.pop_back();
+                closeConnection(fd);
+            }
         }
     }
 
-    void deal(){
-        cout << "\n===== DEALING CARDS =====\n";
-        for (auto& p : m_players){
-            p->getHandRef().clear();
+    size_t connections() const{
+        return m_connections.size();
+    }
+    size_t tables() const{
+        return m_tables.size();
+    }
+#ifdef BLKJCK_INSTRUMENT
+    //Every table the server opened, added up.
+    TableMetrics metrics(){
+        TableMetrics total;
+        for (size_t t = 0; t < m_scheduler.size(); t++){
+            total.merge(m_scheduler.table(static_cast<int>(t)).m_metrics);
         }
-        m_dealer.getHandRef().clear();
+        return total;
+    }
+#endif
+};
+#endif
 
-        /*
-            while performance wise unconventional, i want to stick to real game flow standard
-            usually the deal is done one and a time iteratively, so that's what i'm going with here
-            and probably for any other game related instance.
-        */
 
-        for(auto& p : m_players){
-            p->getHandRef().add(m_dealer.deal());
-        }
-        m_dealer.getHandRef().add(m_dealer.deal());
+/*
+    prints the exact dealer outcome table for a fresh shoe of numDecks decks, one row per upcard,
+    plus stand/hit EVs for a hard 16 (10,6) as an example of the decision numbers.
+*/
+void reportDealerOdds(const TableRules& rules){
+    Deck shoe(rules.numDecks);
+    ShoeComposition full = shoe.getComposition();
+    DealerOddsEngine engine(false, rules);
 
-        for(auto& p : m_players){
-            p->getHandRef().add(m_dealer.deal());
-        }
-        m_dealer.getHandRef().add(m_dealer.deal());
+    auto start = chrono::steady_clock::now();
 
-        displayTable();
+    cout << "\n===== DEALER OUTCOMES (" << rules.numDecks << " deck(s), dealer " << (rules.hitSoft17 ? "hits" : "stands on") << " soft 17) =====\n";
+    cout << setw(5) << left << "Up"
+         << setw(8) << right << "17" << setw(8) << "18" << setw(8) << "19" << setw(8) << "20" << setw(8) << "21"
+         << setw(8) << "Bust" << setw(8) << "BJ"
+         << setw(11) << "Stand 16" << setw(10) << "Hit 16" << endl;
+    cout << "==========================================================================" << endl;
 
-    }
-    void playerTurns(){
-        cout << "\n===== DEALING CARDS =====\n";
+    for (int up = 2; up <= 11; up++){
+        ShoeComposition rest = full;
+        rest[up - 2]--;
+        DealerDistribution dist = engine.dealerOutcomes(rest, up);
 
-        for (auto& p : m_players){
-            cout << "\n" << p->getName() << "'s turn: \n";
-            p->showHand();
+        //Player holding 10,6 against this upcard.
+        ShoeComposition afterPlayer = rest;
+        afterPlayer[8]--;
+        afterPlayer[4]--;
 
+        cout << setw(5) << left << (up == 11 ? string("A") : to_string(up)) << right << fixed << setprecision(4);
+        for (int r = DEALER_17; r <= DEALER_BLACKJACK; r++){
+            cout << setw(8) << dist.p[r];
+        }
+        cout << setw(11) << engine.evStand(afterPlayer, 16, up)
+             << setw(10) << engine.evHit(afterPlayer, 16, false, up) << endl;
+    }
 
-            if (p->isBlackjack()){
-                cout << "Blackjack! " << p->getName() << " stands.\n";
-                logAction(p->getName() + " got a blackjack!");
-                continue;
-            }
+    double seconds = chrono::duration<double>(chrono::steady_clock::now() - start).count();
+    cout << "\nCached states: " << engine.cacheSize() << ", computed in " << setprecision(3) << seconds << " s\n";
+}
 
-            while (!p->isBusted() && p->isHitting()){
-                Card nC = m_dealer.deal();
-                cout << p->getName() << " receives: " << nC.getRank() << " of " << nC.getSuit() << endl;
-                p->getHandRef().add(nC);
 
+/*
+    the whole strategy chart worked out exactly for a fresh shoe under rules, each cell for the actual two
+    cards dealt (the hard rows use 2,x below 12 and 10,x from there up). cells that disagree with the
+    basicStrategy() table the bots play are starred.
+*/
+void reportStrategyChart(const TableRules& rules){
+    Deck shoe(rules.numDecks);
+    ShoeComposition full = shoe.getComposition();
+    DealerOddsEngine engine(true, rules);
+    const char ACTIONLETTERS[] = {'H', 'S', 'D', 'P', 'R'};
+    int differences = 0;
 
-                if (p->isBusted()){
-                    cout << p->getName() << " busts with " << p->getHand().getTotal() << "!\n";
-                    logAction(p->getName() + " busted with " + to_string(p->getHand().getTotal()));
-                }
-                else{
-                    cout << p->getName() << " has " << p->getHand().getTotal() << ".\n";
-                }
-            }
-            if (!p->isBusted()){
-                cout << p->getName() << " stands with " << p->getHand().getTotal() << ".\n";
-                logAction(p->getName() + " stands with " + to_string(p->getHand().getTotal()));
-            }
-        }
-    }
-    void dealerTurn(){
-        cout << "\n===== DEALERS TURN =====\n";
-        bool cleanSweep = true;
-        for (auto& p : m_players){
-            if (!p->isBusted()){
-                cleanSweep = false;
-                break;
-            }
-        }
+    auto start = chrono::steady_clock::now();
 
-        m_dealer.showHand(true);
+    //One row of the chart for the two cards a and b (2-11, ace = 11).
+    auto row = [&](const string& label, int a, int b){
+        cout << setw(6) << left << label << right;
+        bool pair = (a == b);
+        bool aces = (a == 11) + (b == 11) > 0;
+        int hardTotal = (a == 11 ? 1 : a) + (b == 11 ? 1 : b);
+        for (int up = 2; up <= 11; up++){
+            ShoeComposition rest = full;
+            rest[a - 2]--;
+            rest[b - 2]--;
+            rest[up - 2]--;
+            DealerOddsEngine::Decision d = engine.decide(rest, hardTotal, aces, pair ? a : 0, up, true, true, true);
 
-        if (cleanSweep){
-            cout << "Wow! All players have busted, the Dealer wins!\n";
-            logAction("All players busted, dealer wins");
-            return;
+            bool soft = aces && hardTotal + 10 <= 21;
+            int total = soft ? hardTotal + 10 : hardTotal;
+            Action chart = basicStrategy(total, soft, pair ? a : 0, up, rules.canDoubleOn(total, false), rules.maxHands > 1, rules.lateSurrender);
+            bool differs = d.best != chart;
+            differences += differs;
+            cout << setw(3) << ACTIONLETTERS[static_cast<int>(d.best)] << (differs ? '*' : ' ');
         }
-
-        while (m_dealer.isHitting()){
-            Card nC = m_dealer.deal();
-            cout << "Dealer recieves: " << nC.getRank() << " of " << nC.getSuit() << endl;
-            m_dealer.getHandRef().add(nC);
-            cout << "Dealer has " << m_dealer.getHand().getTotal() << ".\n";
+        cout << endl;
+    };
+    auto header = [](const string& title){
+        cout << "\n" << setw(6) << left << title << right;
+        for (int up = 2; up <= 11; up++){
+            cout << setw(3) << (up == 11 ? string("A") : to_string(up)) << ' ';
         }
+        cout << "\n==============================================" << endl;
+    };
 
-        if(m_dealer.isBusted()){
-            cout << "Dealer busts with " << m_dealer.getHand().getTotal() << "!\n";
-            logAction("Dealer busted with " + to_string(m_dealer.getHand().getTotal()));
+    cout << "\n===== EXACT STRATEGY =====\n" << rules.describe() << ", dealer peeks\n";
+    header("Hard");
+    for (int total = 5; total <= 17; total++){
+        if (total < 12){
+            row(to_string(total), 2, total - 2);
         }
         else{
-            cout << "Dealer stands with " << m_dealer.getHand().getTotal() << "!\n";
-            logAction("Dealer stands with " + to_string(m_dealer.getHand().getTotal()));
+            row(to_string(total), 10, total - 10);
         }
-
     }
-    /*
-    
-        payout function based on hand totals and if player or dealer has achieved a blackjack.
-        basic if else ladder logic to determine how much money is either sent out, lost, or pushed
-        back to the players and dealer in the event of a tie.
-    
-    */
-    void payouts(){
-        cout << "\n===== RESULTS =====\n";
+    header("Soft");
+    for (int other = 2; other <= 9; other++){
+        row("A," + to_string(other), 11, other);
+    }
+    header("Pair");
+    for (int value = 2; value <= 11; value++){
+        string card = value == 11 ? string("A") : to_string(value);
+        row(card + "," + card, value, value);
+    }
 
-        int dT = m_dealer.getHand().getTotal();
-        bool dB = m_dealer.isBusted();
-        bool dBJ = m_dealer.isBlackjack();
+    double seconds = chrono::duration<double>(chrono::steady_clock::now() - start).count();
+    cout << "\nH hit, S stand, D double, P split, R surrender. " << differences << " cell(s) differ from the basic strategy table (*).\n";
+    cout << "Cached states: " << engine.cacheSize() << ", computed in " << fixed << setprecision(3) << seconds << " s\n";
+}
 
-        for (auto& p : m_players){
 
-            string name = p->getName();
-            int pT = p->getHand().getTotal();
-            bool pB = p->isBusted();
-            bool pBJ = p->isBlackjack();
-
-            cout << name << ": ";
-
-            if (pB){
-                p->lose();
-                m_stats.recordLoss(name);
-                cout << "Busted and lost $" << p->getBet() << ".\n";
-                logAction(name + "lost $" + to_string(p->getBet()));
-            }
-            else if (dB){
-                p->win();
-                m_stats.recordWin(name);
-                cout << "Won $" << p->getBet() << " (dealer busted).\n";
-                logAction(name + " won $" + to_string(p->getBet()) + " (dealer busted)");
-            }
-            else if(pBJ && !dBJ){
-                int wins = static_cast<int>(p->getBet() * 1.5);
-                m_stats.recordWin(name);
-                cout << "Blackjack! Won $" << wins << ".\n";
-                logAction(name + "won $" + to_string(wins) + "with blackjack.");
-                p->win();
-            }
-            else if(!pBJ && dBJ){
-                p->lose();
-                m_stats.recordLoss(name);
-                cout << "Lost $" << p->getBet() << " the dealer's blackjack. \n";
-                logAction(name + "lost $ " + to_string(p->getBet()) + " to dealer's blackjack");
-            }
-            else if (pT > dT){
-                p->win();
-                m_stats.recordWin(name);
-                cout << "Won $ " << p->getBet() << " with " << pT << " over dealer's " << dT << ".\n";
-                logAction(name + "won $" + to_string(p->getBet()));
-            }
-            else if (pT < dT){
-                p->lose();
-                m_stats.recordLoss(name);
-                cout << "Lost $" << p->getBet() << " with " << pT << " under dealer's " << dT << ".\n";
-                logAction(name + " lost $" + to_string(p->getBet())); 
-            }
-            else{
-                p->push();
-                cout << "Push. Bet of $" << p->getBet() << " returned.\n";
-                logAction(name + " pushed with dealer at " + to_string(pT));
-            }
+/*
+    times the per-seat payout ladder against the batch kernel over the same randomly dealt hands,
+    as if settling a big pile of simulated tables at once, and checks the two agree hand for hand.
+*/
+void benchmarkSettlement(long long hands, uint64_t seedValue){
+    HandBatch batch;
+    mt19937_64 rng(seedValue);
+    uniform_int_distribution<int> playerTotal(12, 26);
+    uniform_int_distribution<int> dealerTotal(17, 26);
+    uniform_int_distribution<int> wager(1, 100);
+    bernoulli_distribution natural(0.047);
+    for (long long i = 0; i < hands; i++){
+        bool pBJ = natural(rng);
+        bool dBJ = natural(rng);
+        batch.add(pBJ ? 21 : playerTotal(rng), pBJ, dBJ ? 21 : dealerTotal(rng), dBJ, wager(rng));
+    }
 
-            m_stats.updateHighScore(name, p->getMoney());
+    const double blackjackPays = 1.5;
+    const int repeats = 5;
+    vector<int32_t> seatNet(batch.size());
+    double seatSeconds = 1e9;
+    double batchSeconds = 1e9;
 
-        }
-    }
-    void cleanup(){
-        auto rP = m_players.begin();
-        while (rP != m_players.end()){
-            if ((*rP)->getMoney()<=0){
-                cout << (*rP)->getName() << " is out of money and forfeits the game.\n";
-                logAction( (*rP)->getName() + " left the game (out of money)");
-                rP = m_players.erase(rP);
+    for (int r = 0; r < repeats; r++){
+        auto start = chrono::steady_clock::now();
+        for (size_t i = 0; i < batch.size(); i++){
+            HandOutcome result = settleHand(batch.playerTotal[i], batch.playerBlackjack[i], batch.dealerTotal[i], batch.dealerBlackjack[i]);
+            int bet = batch.bet[i];
+            if (result == OUTCOME_BLACKJACK){
+                seatNet[i] = static_cast<int32_t>(bet * blackjackPays);
             }
             else{
-                rP++;
+                seatNet[i] = result * bet;
             }
         }
-        processEvents();
+        seatSeconds = min(seatSeconds, chrono::duration<double>(chrono::steady_clock::now() - start).count());
 
-        m_stats.displayStats();
-        m_stats.displayHighScores();
+        start = chrono::steady_clock::now();
+        settleHands(batch, blackjackPays);
+        batchSeconds = min(batchSeconds, chrono::duration<double>(chrono::steady_clock::now() - start).count());
     }
 
-    /*
-        this function stays OUT of the playerstats class because it's to be used in between rounds of blackjack.
-    */
-    void findMinMaxMoney(){
-        if (m_players.empty()){
-            cout <<"No players at table to value!\n";
-            return ;
-        }
+    long long mismatches = 0;
+    long long net = 0;
+    for (size_t i = 0; i < batch.size(); i++){
+        mismatches += (seatNet[i] != batch.net[i]);
+        net += batch.net[i];
+    }
 
-        int min = numeric_limits<int>::max();
-        int max = 0;
-        string richest = "";
-        string poorest = "";
+    cout << "\n===== SETTLEMENT BENCHMARK =====\n";
+    cout << "Hands:          " << hands << " (best of " << repeats << ")\n";
+    cout << "Per seat:       " << fixed << setprecision(2) << seatSeconds * 1e9 / hands << " ns/hand\n";
+    cout << "Batch kernel:   " << batchSeconds * 1e9 / hands << " ns/hand\n";
+    cout << "Speedup:        " << seatSeconds / batchSeconds << "x\n";
+    cout << "Players net:    $" << net << endl;
+    cout << "Mismatches:     " << mismatches << endl;
+}
 
-        for (const auto& p : m_players){
-            if(p->getMoney() > max) {
-                richest = p->getName();
-                max = p->getMoney();
-            }
 
-            if (p->getMoney() < min){
-                poorest = p->getName();
-                min = p->getMoney();
-            }
-            
-        }
+void printUsage(const char* program){
+    cout << "Usage: " << program << " [options]\n"
+         << "  (no options)         play at the terminal (--decks and --penetration apply here too)\n"
+         << "  --simulate N         play N rounds headless with basic strategy bots and report the house edge\n"
+         << "  --players P          bots at the simulated table (default 1)\n"
+         << "  --bet B              flat bet for each bot, the unit bet policies size from (default 10)\n"
+         << "  --bet-policy SPEC    how bots size bets: flat, kelly[:FRACTION], ramp[:SPREAD] or martingale[:DOUBLINGS]\n"
+         << "  --count SYSTEM       count the bet policies read: hilo, ko, hiopt2, omega2 or zen (default hilo)\n"
+         << "  --sessions S         play S sessions of --simulate rounds each and report risk of ruin and drawdowns\n"
+         << "  --bankroll B         what each bot starts with (default 1000 a session, without --sessions 1000 bets\n"
+         << "                       under a bet policy and unlimited for flat betting)\n"
+         << "  --threads T          simulation worker threads, 0 uses every core (default 1)\n"
+         << "  --seed S             seed for the shoe, the base seed when simulating (default random)\n"
+         << "  --decks D            decks in the shoe (default 1)\n"
+         << "  --penetration F      fraction of the shoe dealt before the cut card, 0-1 (default 0.75)\n"
+         << "  --h17                dealer hits soft 17 (default stands)\n"
+         << "  --blackjack-pays P   3:2, 6:5 or 1:1 (default 3:2)\n"
+         << "  --double RULE        what can be doubled: any, 9-11 or 10-11 (default any)\n"
+         << "  --no-das             no doubling after a split\n"
+         << "  --max-hands N        hands a seat can split to, 1 turns splitting off (default 4)\n"
+         << "  --no-surrender       no late surrender\n"
+         << "  --profiles FILE      saved player profiles (default blackjack_profiles.dat)\n"
+         << "  --log FILE           write the action log to FILE in the background (FILE.N per simulation thread)\n"
+         << "  --record FILE        record a replay of the session to FILE (FILE.N per simulation thread)\n"
+         << "  --history FILE       export every settled hand to FILE as a columnar hand history (FILE.N per simulation\n"
+         << "                       thread), blackjack_history summarizes it\n"
+         << "  --replay FILE        play a recorded session back headless and check it ends the same way\n"
+         << "  --dealer-odds        print the exact dealer outcome table for a fresh shoe of --decks decks\n"
+         << "  --strategy-chart     work out the whole strategy chart exactly for a fresh shoe of --decks decks\n"
+         << "  --bench-settle N     time the per seat payout ladder against the batch kernel over N random hands\n"
+         << "  --serve PORT         host tables for players connecting over TCP (Linux only)\n"
+         << "  --host ADDR          address the server listens on (default 127.0.0.1)\n"
+         << "  --turn-timeout S     seconds a server table waits on a bet or decision (default 30)\n"
+         << "  --metrics FILE       where the per phase timings go at shutdown, JSON if FILE ends in .json\n"
+         << "                       (needs a build with BLKJCK_INSTRUMENT, which prints them to the terminal otherwise)\n";
+}
 
-        cout << "\n=====PLAYER MONEY STATS=====\n";
-        cout << "Current Top Earner: " << richest << " with $" << max << endl;
-        cout << "Current Low Earner: " << poorest << " with $" << min << endl;
-    }
-    
-    // Game state management
-    void setState(GameState state){
-        m_currentState = state;
-    }
-    GameState getState() const{
-        return m_currentState;
+
+#ifdef BLKJCK_INSTRUMENT
+void reportMetrics(const TableMetrics& metrics, const string& path){
+    if (!metrics.write(path)){
+        cout << "Couldn't write the table metrics to " << path << "." << endl;
     }
-    
-    // Game utilities
-    void displayTable() const{
-        cout << "\n===== TABLE STATUS =====\n";
-        m_dealer.showHand(false);
-        for (const auto& p: m_players){
-            cout << p->getName() << " ($" << p->getMoney() << ", bet: $" << p->getBet() << "): ";
-            p->getHand().toString();
-            cout << endl;
+}
+#endif
+
+
+/*
+    the benchmark suite includes this file whole to get at the classes, and brings its own main.
+*/
+#ifndef BLKJCK_NO_MAIN
+int main(int argc, char* argv[]) {
+    long long simRounds = 0;
+    int simPlayers = 1;
+    int simBet = 10;
+    int simThreads = 1;
+    long long simSessions = 0;
+    int simBankroll = 0;
+    string betPolicy;
+    const CountSystem* countSystem = nullptr;
+    uint64_t simSeed = random_device{}();
+    bool seeded = false;
+    int numDecks = 1;
+    double penetration = DEFAULTPENETRATION;
+    TableRules rules;
+    bool dealerOdds = false;
+    bool strategyChart = false;
+    long long benchHands = 0;
+    string logPath;
+    string recordPath;
+    string historyPath;
+    string replayPath;
+    string metricsPath;
+    string profilesPath = "blackjack_profiles.dat";
+    int servePort = 0;
+    string serveHost = "127.0.0.1";
+    double turnTimeout = 30.0;
+
+    for (int i = 1; i < argc; i++){
+        string arg = argv[i];
+        bool hasValue = (i + 1 < argc);
+
+        if (arg == "--simulate" && hasValue){
+            simRounds = atoll(argv[++i]);
+        }
+        else if (arg == "--players" && hasValue){
+            simPlayers = atoi(argv[++i]);
+        }
+        else if (arg == "--bet" && hasValue){
+            simBet = atoi(argv[++i]);
+        }
+        else if (arg == "--bet-policy" && hasValue){
+            betPolicy = argv[++i];
+        }
+        else if (arg == "--count" && hasValue && counts::find(argv[i + 1])){
+            countSystem = counts::find(argv[++i]);
+        }
+        else if (arg == "--sessions" && hasValue){
+            simSessions = atoll(argv[++i]);
+        }
+        else if (arg == "--bankroll" && hasValue){
+            simBankroll = atoi(argv[++i]);
+        }
+        else if (arg == "--threads" && hasValue){
+            simThreads = atoi(argv[++i]);
+            if (simThreads == 0){
+                simThreads = max(1u, thread::hardware_concurrency());
+            }
+        }
+        else if (arg == "--seed" && hasValue){
+            simSeed = strtoull(argv[++i], nullptr, 10);
+            seeded = true;
+        }
+        else if (arg == "--decks" && hasValue){
+            numDecks = atoi(argv[++i]);
+        }
+        else if (arg == "--penetration" && hasValue){
+            penetration = atof(argv[++i]);
+        }
+        else if (arg == "--h17"){
+            rules.hitSoft17 = true;
+        }
+        else if (arg == "--blackjack-pays" && hasValue && TableRules::parsePayout(argv[i + 1], rules.blackjackPays)){
+            i++;
+        }
+        else if (arg == "--double" && hasValue && TableRules::parseDoubleRule(argv[i + 1], rules.doubleOn)){
+            i++;
+        }
+        else if (arg == "--no-das"){
+            rules.doubleAfterSplit = false;
+        }
+        else if (arg == "--max-hands" && hasValue){
+            rules.maxHands = atoi(argv[++i]);
+        }
+        else if (arg == "--no-surrender"){
+            rules.lateSurrender = false;
+        }
+        else if (arg == "--profiles" && hasValue){
+            profilesPath = argv[++i];
+        }
+        else if (arg == "--log" && hasValue){
+            logPath = argv[++i];
+        }
+        else if (arg == "--record" && hasValue){
+            recordPath = argv[++i];
+        }
+        else if (arg == "--history" && hasValue){
+            historyPath = argv[++i];
+        }
+        else if (arg == "--replay" && hasValue){
+            replayPath = argv[++i];
+        }
+        else if (arg == "--metrics" && hasValue){
+            metricsPath = argv[++i];
+        }
+        else if (arg == "--serve" && hasValue){
+            servePort = atoi(argv[++i]);
+        }
+        else if (arg == "--host" && hasValue){
+            serveHost = argv[++i];
+        }
+        else if (arg == "--turn-timeout" && hasValue){
+            turnTimeout = atof(argv[++i]);
+        }
+        else if (arg == "--bench-settle" && hasValue){
+            benchHands = atoll(argv[++i]);
+        }
+        else if (arg == "--dealer-odds"){
+            dealerOdds = true;
+        }
+        else if (arg == "--strategy-chart"){
+            strategyChart = true;
+        }
+        else{
+            printUsage(argv[0]);
+            return (arg == "--help" || arg == "-h") ? 0 : 1;
         }
     }
-    void logAction(const string& action){
-        m_actionLog.push(action);
+
+    if (numDecks <= 0 || penetration <= 0.0 || penetration > 1.0 || rules.maxHands < 1 || rules.maxHands > MAXHANDS){
+        printUsage(argv[0]);
+        return 1;
     }
-    void displayActionLog() const{
-        cout << "\n===== ACTION LOG =====\n";
+    rules.numDecks = numDecks;
 
-        if (m_actionLog.empty()){
-            cout << "No actions currently logged.\n";
-            return ;
-        }
+#ifndef BLKJCK_INSTRUMENT
+    if (!metricsPath.empty()){
+        cout << "This build has no instrumentation, rebuild with BLKJCK_INSTRUMENT defined to get --metrics." << endl;
     }
-    void queueEvent(const string& event, int priority){
-        m_events.push(make_pair(priority, event));
+#endif
+
+    if (dealerOdds){
+        reportDealerOdds(rules);
+        return 0;
     }
-    void processEvents(){
-        while (!m_events.empty()){
-            cout << "EVENT: " << m_events.top().second << endl;
-            m_events.pop();
-        }
+    if (strategyChart){
+        reportStrategyChart(rules);
+        return 0;
     }
-    
-    // Menu system
-    void displayMenu() const{
-        cout << "\n=====MENU=====\n";
-        cout << "\n1. Play Game\n";
-        cout << "\n2. Create Player Profile\n";
-        cout << "\n3. Load Player Profile\n";
-        cout << "\n4. View Stats\n";
-        cout << "\n5. View High Scores\n";
-        cout << "\n6. Quit Game\n";
+    if (benchHands > 0){
+        benchmarkSettlement(benchHands, simSeed);
+        return 0;
     }
-    void showWelcomeScreen() const{
-        cout << "\n=====WELCOME TO BLACKJACK! WITH FRIENDS=====\n";
-        cout << "\n=====Your goal as the player is to try and beat the dealer by getting as close to 21 without going over!\n";
-        cout << "\n=====Each player starts with two cards. The dealer's first card is hidden.\n";
-        cout << "\n=====Each player also must decide to hit (take another card), or stand (stop taking cards).\n";
-        cout << "\n=====The dealer will play against you! With some mental math and a little bit of luck, you could get rich!\n";
-        cout << "\n=====To get started, each of you must create a player profile with your name!\n";
-        cout << "\n=====Good luck, and have fun!\n" << endl;
+    if (!replayPath.empty()){
+        Game replayed;
+        SessionReplay replay;
+        if (!replay.open(replayPath)){
+            cout << "Couldn't read " << replayPath << ": " << replay.error() << endl;
+            return 1;
+        }
+        if (!logPath.empty() && !replayed.startActionLogWriter(logPath)){
+            cout << "Couldn't open " << logPath << " for the action log." << endl;
+            return 1;
+        }
+        if (!historyPath.empty() && !replayed.startHandHistory(historyPath)){
+            cout << "Couldn't open " << historyPath << " for the hand history." << endl;
+            return 1;
+        }
+        bool ok = replay.run(replayed);
+        replay.report(replayed);
+#ifdef BLKJCK_INSTRUMENT
+        reportMetrics(replayed.m_metrics, metricsPath);
+#endif
+        return (ok && (replay.matches() || !replay.verified())) ? 0 : 1;
     }
-    void createPlayerProfile(){
-        string newName = "";
-        int nMoney = 1000;
-
-        cout << "Enter your name:";
-        cin.ignore(numeric_limits<streamsize>::max(), '\n');
-        getline(cin, newName);
-
-        auto alrExist = find_if(m_players.begin(), m_players.end(), [&newName](const unique_ptr<Player>&p){
-            return p->getName() == newName;
-        });  
 
-        if (alrExist != m_players.end()){
-            cout << "Player already exists." << endl;
-            return;
+    if (servePort > 0){
+#ifdef BLKJCK_HAVE_EPOLL
+        if (turnTimeout <= 0.0){
+            printUsage(argv[0]);
+            return 1;
         }
-
-        cout << "\nCreating new profile for " << newName << " with $ " << nMoney << " to start with." << endl;
-
-        Player nP(newName, nMoney);
-        addPlayer(nP);
-        
-        cout << "\nPlayer profile created successfully!\n" << endl;
+        TableServer server(rules, penetration, static_cast<int>(turnTimeout * 1000.0));
+        if (!server.listen(serveHost, servePort)){
+            perror("Couldn't start the server");
+            return 1;
+        }
+        cout << "Serving blackjack on " << serveHost << ":" << servePort << ", Ctrl+C to stop." << endl;
+        cout << "Rules: " << rules.describe() << endl;
+        server.run();
+        cout << "Server stopped with " << server.connections() << " connection(s) across " << server.tables() << " table(s)." << endl;
+#ifdef BLKJCK_INSTRUMENT
+        reportMetrics(server.metrics(), metricsPath);
+#endif
+        return 0;
+#else
+        cout << "Server mode needs epoll, which this platform doesn't have." << endl;
+        return 1;
+#endif
     }
-    
-    void loadPlayerProfile(){
-        string pName;
-
-        cout << "Enter your profile name: ";
-        cin.ignore(numeric_limits<streamsize>::max(), '\n');
-        getline(cin, pName);
-
-        auto alrExists = find_if(m_players.begin(), m_players.end(), [&pName](const unique_ptr<Player>& p) {
-             return p->getName() == pName; 
-        });
 
-        if (alrExists != m_players.end()) {
-        cout << "Welcome back, " << pName << "!\n";
-        cout << "Current balance: $" << (*alrExists)->getMoney() << "\n";
-        
-        // Display player stats
-        cout << "Wins: " << m_stats.getWins(pName) << "\n";
-        cout << "Losses: " << m_stats.getLosses(pName) << "\n";
-        cout << "Win rate: " << fixed << setprecision(1) << (m_stats.getWinRate(pName) * 100) << "%\n";
-        } else {
-            cout << "Player profile not found. Create a new profile? (y/n): ";
-            char choice;
-            cin >> choice;
-            cin.ignore(numeric_limits<streamsize>::max(), '\n');
-        
-            if (choice == 'y' || choice == 'Y') {
-            createPlayerProfile();
-            }
+    if (simRounds > 0){
+        if (simPlayers <= 0 || simBet <= 0 || simThreads < 0 || simSessions < 0 || simBankroll < 0
+            || (!betPolicy.empty() && !makeBetPolicy(betPolicy, simBet))){
+            printUsage(argv[0]);
+            return 1;
+        }
+        if (simBankroll == 0){
+            //Policies size bets off the bankroll, so an unlimited one would have them staking millions.
+            simBankroll = simSessions ? 1000 : betPolicy.empty() ? 1000000000 : static_cast<int>(min(1000LL * simBet, 1000000000LL));
+        }
+        Simulator sim(simRounds, simPlayers, simBet, simThreads, simSeed, rules, penetration, simBankroll);
+        sim.setSessions(simSessions);
+        sim.setBetPolicy(betPolicy);
+        if (countSystem){
+            sim.setCountSystem(*countSystem);
         }
+        sim.setLogPath(logPath);
+        sim.setRecordPath(recordPath);
+        sim.setHistoryPath(historyPath);
+        sim.run();
+        sim.report();
+#ifdef BLKJCK_INSTRUMENT
+        reportMetrics(sim.getMetrics(), metricsPath);
+#endif
+        return 0;
     }
-};
 
-
-int main() {
     Game gameinst;
+    gameinst.configureShoe(numDecks, penetration);
+    gameinst.setRules(rules);
+    if (seeded){
+        gameinst.seed(simSeed);
+    }
+    if (!recordPath.empty() && !gameinst.startRecording(recordPath)){
+        cout << "Couldn't open " << recordPath << " to record the session." << endl;
+        return 1;
+    }
+    if (!logPath.empty() && !gameinst.startActionLogWriter(logPath)){
+        cout << "Couldn't open " << logPath << " for the action log." << endl;
+        return 1;
+    }
+    if (!historyPath.empty() && !gameinst.startHandHistory(historyPath)){
+        cout << "Couldn't open " << historyPath << " for the hand history." << endl;
+        return 1;
+    }
+    if (!gameinst.openProfiles(profilesPath)){
+        cout << "Couldn't open " << profilesPath << ", profiles won't be saved this time." << endl;
+    }
     bool exit = false;
     while (!exit){
 
@@ -1049,14 +7256,22 @@ int main() {
                 break;
             }
             case 4:{
-                gameinst.displayStats();
+                gameinst.m_stats.displayStats();
                 break;
             }
             case 5:{
-                gameinst.displayHighScores();
+                gameinst.m_stats.displayHighScores();
                 break;
             }
             case 6:{
+                gameinst.addBotPlayer();
+                break;
+            }
+            case 7:{
+                gameinst.displayActionLog();
+                break;
+            }
+            case 8:{
                 exit = true;
                 break;
             }
@@ -1066,6 +7281,10 @@ int main() {
             }
         }
     }
+#ifdef BLKJCK_INSTRUMENT
+    reportMetrics(gameinst.m_metrics, metricsPath);
+#endif
     cout << "Goodbye!" << endl;
     return 0;
 }
+#endif
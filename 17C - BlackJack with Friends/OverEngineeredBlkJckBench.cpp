@@ -0,0 +1,398 @@
+/*
+    microbenchmarks for the hot paths of OverEngineeredBlkJck.cpp, built on Google Benchmark.
+
+    the game is a single file, so this pulls the whole thing in with main() switched off and
+    benchmarks the classes directly. build the blackjack_bench target (see CMakeLists.txt) in Release
+    and run it with --benchmark_filter=<regex> to pick out a group.
+*/
+
+#define BLKJCK_NO_MAIN
+#include "OverEngineeredBlkJck.cpp"
+
+#include <benchmark/benchmark.h>
+
+
+//Shoe sizes most tables actually use.
+static void deckCounts(benchmark::internal::Benchmark* b){
+    for (int decks : {1, 2, 6, 8}){
+        b->Arg(decks);
+    }
+}
+
+
+/*
+    one full Fisher-Yates pass over a shoe of range(0) decks.
+*/
+static void BM_DeckShuffle(benchmark::State& state){
+    Deck deck(static_cast<int>(state.range(0)));
+    deck.seed(1);
+
+    for (auto _ : state){
+        deck.shuffleDeck();
+        benchmark::ClobberMemory();
+    }
+    state.SetItemsProcessed(state.iterations() * deck.cardsRemaining());
+}
+BENCHMARK(BM_DeckShuffle)->Apply(deckCounts);
+
+/*
+    deals one card and throws it straight on the discard pile, so the shoe keeps recycling itself.
+    the reshuffle when it runs dry is part of the cost, spread over a shoe's worth of deals.
+*/
+static void BM_DeckDeal(benchmark::State& state){
+    Deck deck(static_cast<int>(state.range(0)));
+    deck.seed(1);
+    deck.shuffleDeck();
+
+    for (auto _ : state){
+        Card card = deck.deal();
+        benchmark::DoNotOptimize(card);
+        deck.addToDiscardPile(card);
+    }
+    state.SetItemsProcessed(state.iterations());
+}
+BENCHMARK(BM_DeckDeal)->Apply(deckCounts);
+
+//The count the bet spread reads every round.
+static void BM_DeckTrueCount(benchmark::State& state){
+    Deck deck(static_cast<int>(state.range(0)));
+    deck.seed(1);
+    deck.shuffleDeck();
+    for (int i = 0; i < deck.cardsRemaining() / 2; i++){
+        deck.deal();
+    }
+
+    for (auto _ : state){
+        benchmark::DoNotOptimize(deck.trueCount());
+    }
+}
+BENCHMARK(BM_DeckTrueCount)->Apply(deckCounts);
+
+static void BM_DeckComposition(benchmark::State& state){
+    Deck deck(static_cast<int>(state.range(0)));
+    deck.seed(1);
+    deck.shuffleDeck();
+
+    for (auto _ : state){
+        ShoeComposition shoe = deck.getComposition();
+        benchmark::DoNotOptimize(shoe);
+    }
+}
+BENCHMARK(BM_DeckComposition)->Apply(deckCounts);
+
+
+/*
+    getTotal() on a hand of range(0) cards, with an ace in it so the soft total gets worked out too.
+*/
+static void BM_HandGetTotal(benchmark::State& state){
+    Hand hand;
+    hand.add(Card(0, ACE));
+    for (int i = 1; i < state.range(0); i++){
+        hand.add(Card(i % NUMSUITS, i % 4));
+    }
+
+    for (auto _ : state){
+        benchmark::DoNotOptimize(hand.getTotal());
+    }
+}
+BENCHMARK(BM_HandGetTotal)->Arg(2)->Arg(3)->Arg(5)->Arg(8);
+
+//Building a hand up card by card and clearing it, the way every round does.
+static void BM_HandAddClear(benchmark::State& state){
+    Hand hand;
+    int cards = static_cast<int>(state.range(0));
+
+    for (auto _ : state){
+        for (int i = 0; i < cards; i++){
+            hand.add(Card(i % NUMSUITS, i % NUMRANKS));
+        }
+        benchmark::DoNotOptimize(hand.getTotal());
+        hand.clear();
+    }
+    state.SetItemsProcessed(state.iterations() * cards);
+}
+BENCHMARK(BM_HandAddClear)->Arg(2)->Arg(3)->Arg(5);
+
+
+/*
+    every decision on the strategy chart (hard 5-17, soft 13-20 and the pairs, against each upcard)
+    solved exactly for a fresh shoe of range(0) decks, starting from an empty cache each time.
+*/
+static void BM_SolveStrategyChart(benchmark::State& state){
+    ShoeComposition full = Deck(static_cast<int>(state.range(0))).getComposition();
+    vector<pair<int, int>> hands;
+    for (int total = 5; total <= 17; total++){
+        hands.push_back(total < 12 ? make_pair(2, total - 2) : make_pair(10, total - 10));
+    }
+    for (int other = 2; other <= 9; other++){
+        hands.push_back(make_pair(11, other));
+    }
+    for (int value = 2; value <= 11; value++){
+        hands.push_back(make_pair(value, value));
+    }
+
+    for (auto _ : state){
+        DealerOddsEngine engine(true);
+        for (const auto& hand : hands){
+            int a = hand.first;
+            int b = hand.second;
+            for (int up = 2; up <= 11; up++){
+                ShoeComposition rest = full;
+                rest[a - 2]--;
+                rest[b - 2]--;
+                rest[up - 2]--;
+                int hardTotal = (a == 11 ? 1 : a) + (b == 11 ? 1 : b);
+                benchmark::DoNotOptimize(engine.decide(rest, hardTotal, a == 11 || b == 11, a == b ? a : 0, up, true, true, true));
+            }
+        }
+    }
+    state.SetItemsProcessed(state.iterations() * hands.size() * NUMUPCARDS);
+}
+BENCHMARK(BM_SolveStrategyChart)->Arg(1)->Arg(6)->Unit(benchmark::kMillisecond);
+
+
+/*
+    moves one of range(0) players already on the leaderboard to a new money total.
+*/
+static void BM_UpdateHighScore(benchmark::State& state){
+    int players = static_cast<int>(state.range(0));
+    GameStats stats;
+    vector<string> names;
+    mt19937 rng(7);
+    for (int i = 0; i < players; i++){
+        names.push_back("Player " + to_string(i));
+        stats.updateHighScore(names.back(), rng() % 100000);
+    }
+
+    const size_t PICKS = 4096;
+    vector<pair<int, int>> picks(PICKS);
+    for (auto& pick : picks){
+        pick = make_pair(static_cast<int>(rng() % players), static_cast<int>(rng() % 100000));
+    }
+
+    size_t i = 0;
+    for (auto _ : state){
+        const pair<int, int>& pick = picks[i++ & (PICKS - 1)];
+        stats.updateHighScore(names[pick.first], pick.second);
+    }
+    state.SetItemsProcessed(state.iterations());
+}
+BENCHMARK(BM_UpdateHighScore)->Arg(10)->Arg(1000)->Arg(100000);
+
+static void BM_LeaderboardRank(benchmark::State& state){
+    int players = static_cast<int>(state.range(0));
+    GameStats stats;
+    vector<string> names;
+    mt19937 rng(7);
+    for (int i = 0; i < players; i++){
+        names.push_back("Player " + to_string(i));
+        stats.updateHighScore(names.back(), rng() % 100000);
+    }
+
+    size_t i = 0;
+    for (auto _ : state){
+        benchmark::DoNotOptimize(stats.getRank(names[i++ % players]));
+    }
+}
+BENCHMARK(BM_LeaderboardRank)->Arg(10)->Arg(1000)->Arg(100000);
+
+/*
+    one bankroll into the quantile sketch, the per seat per round cost of the streaming bankroll stats.
+*/
+static void BM_QuantileSketchAdd(benchmark::State& state){
+    QuantileSketch sketch;
+    mt19937 rng(5);
+    vector<int> money(4096);
+    for (int& m : money){
+        m = rng() % 100000;
+    }
+
+    size_t i = 0;
+    for (auto _ : state){
+        sketch.add(money[i++ & 4095]);
+    }
+    benchmark::DoNotOptimize(sketch.quantile(0.5));
+    state.SetItemsProcessed(state.iterations());
+}
+BENCHMARK(BM_QuantileSketchAdd);
+
+
+/*
+    settling range(0) random hands, one at a time down the payout ladder and then all at once
+    through the batch kernel.
+*/
+static HandBatch randomHands(size_t hands){
+    HandBatch batch;
+    mt19937_64 rng(3);
+    uniform_int_distribution<int> playerTotal(12, 26);
+    uniform_int_distribution<int> dealerTotal(17, 26);
+    uniform_int_distribution<int> wager(1, 100);
+    bernoulli_distribution natural(0.047);
+    for (size_t i = 0; i < hands; i++){
+        bool pBJ = natural(rng);
+        bool dBJ = natural(rng);
+        batch.add(pBJ ? 21 : playerTotal(rng), pBJ, dBJ ? 21 : dealerTotal(rng), dBJ, wager(rng));
+    }
+    return batch;
+}
+
+static void BM_SettlePerSeat(benchmark::State& state){
+    HandBatch batch = randomHands(static_cast<size_t>(state.range(0)));
+    vector<int32_t> net(batch.size());
+
+    for (auto _ : state){
+        for (size_t i = 0; i < batch.size(); i++){
+            HandOutcome result = settleHand(batch.playerTotal[i], batch.playerBlackjack[i], batch.dealerTotal[i], batch.dealerBlackjack[i]);
+            net[i] = result == OUTCOME_BLACKJACK ? static_cast<int32_t>(batch.bet[i] * 1.5) : result * batch.bet[i];
+        }
+        benchmark::ClobberMemory();
+    }
+    state.SetItemsProcessed(state.iterations() * batch.size());
+}
+BENCHMARK(BM_SettlePerSeat)->Arg(1024)->Arg(65536);
+
+static void BM_SettleBatch(benchmark::State& state){
+    HandBatch batch = randomHands(static_cast<size_t>(state.range(0)));
+
+    for (auto _ : state){
+        settleHands(batch, 1.5);
+        benchmark::ClobberMemory();
+    }
+    state.SetItemsProcessed(state.iterations() * batch.size());
+}
+BENCHMARK(BM_SettleBatch)->Arg(1024)->Arg(65536);
+
+//The same batch through the kernel specialized for the table payout range(1) (3:2, 6:5, 1:1).
+static void BM_SettleBatchPayout(benchmark::State& state){
+    HandBatch batch = randomHands(static_cast<size_t>(state.range(0)));
+    BlackjackPayout pays = static_cast<BlackjackPayout>(state.range(1));
+
+    for (auto _ : state){
+        settleHands(batch, pays);
+        benchmark::ClobberMemory();
+    }
+    state.SetItemsProcessed(state.iterations() * batch.size());
+}
+BENCHMARK(BM_SettleBatchPayout)->ArgsProduct({{1024, 65536}, {0, 1, 2}});
+
+//Everything GameStats keeps per settled hand, counters, upcard record and the streaming edge stats.
+static void BM_RecordHand(benchmark::State& state){
+    GameStats stats;
+    HandBatch batch = randomHands(4096);
+    settleHands(batch, BlackjackPayout::THREE_TO_TWO);
+
+    size_t i = 0;
+    for (auto _ : state){
+        size_t h = i++ & 4095;
+        stats.recordHand(static_cast<int>(h & 3), 2 + static_cast<int>(h % NUMUPCARDS), batch.bet[h], batch.net[h]);
+    }
+    benchmark::DoNotOptimize(stats.getHouseEdgeMargin());
+    state.SetItemsProcessed(state.iterations());
+}
+BENCHMARK(BM_RecordHand);
+
+
+/*
+    the table every round benchmark plays at: headless, seed 11, players basic strategy bots betting
+    $10, and a shuffled shoe. with a policy spec the bots size their bets by that instead, off a $1M
+    bankroll, since kelly staking a fraction of a billion isn't a table anyone plays at. flat bettors get
+    the billion so they never run out. set up the shoe and rules first, the seed goes in after them.
+*/
+static void seatBots(Game& table, int players, const char* policy = nullptr){
+    table.setHeadless(true);
+    table.seed(11);
+    for (int i = 1; i <= players; i++){
+        int bankroll = policy ? 1000000 : 1000000000;
+        table.addPlayer(make_unique<BotPlayer>("Bot " + to_string(i), bankroll, 10, policy ? makeBetPolicy(policy, 10) : nullptr));
+    }
+    table.m_dealer.shuffleDeck();
+}
+
+//A seat that went broke leaves the table lighter, and the time a round would be for fewer players.
+static void checkSeats(benchmark::State& state, const Game& table, int players){
+    if (static_cast<int>(table.m_players.size()) != players){
+        state.SkipWithError("bots went broke partway, the timing is for an emptier table");
+    }
+}
+
+/*
+    a whole headless round (bets, deal, bot turns, dealer, payouts, cleanup) at a table of
+    range(0) basic strategy bots with a shoe of range(1) decks. items are hands played.
+*/
+static void BM_GameRound(benchmark::State& state){
+    int players = static_cast<int>(state.range(0));
+    Game table;
+    table.configureShoe(static_cast<int>(state.range(1)));
+    seatBots(table, players);
+
+    for (auto _ : state){
+        table.playRound();
+    }
+    state.SetItemsProcessed(state.iterations() * players);
+}
+BENCHMARK(BM_GameRound)->ArgsProduct({{1, 3, 7}, {1, 6}});
+
+//The same table exporting every hand to a hand history thrown away in /dev/null, so only the encoding counts.
+static void BM_GameRoundHistory(benchmark::State& state){
+    int players = static_cast<int>(state.range(0));
+    Game table;
+    table.configureShoe(6);
+    seatBots(table, players);
+    table.startHandHistory("/dev/null");
+
+    for (auto _ : state){
+        table.playRound();
+    }
+    state.SetItemsProcessed(state.iterations() * players);
+}
+BENCHMARK(BM_GameRoundHistory)->Arg(1)->Arg(7);
+
+/*
+    7 bots on a 6 deck shoe under a few of the rule sets a sweep goes through, range(0) picks one:
+    the default table, hits soft 17, 6:5 with no double after split or surrender, doubles on 10-11 only.
+*/
+static void BM_GameRoundRules(benchmark::State& state){
+    TableRules rules;
+    rules.numDecks = 6;
+    switch (state.range(0)){
+        case 1:
+            rules.hitSoft17 = true;
+            break;
+        case 2:
+            rules.blackjackPays = BlackjackPayout::SIX_TO_FIVE;
+            rules.doubleAfterSplit = false;
+            rules.lateSurrender = false;
+            break;
+        case 3:
+            rules.doubleOn = DoubleRule::TEN_OR_ELEVEN;
+            break;
+    }
+    Game table;
+    table.setRules(rules);
+    seatBots(table, 7);
+
+    for (auto _ : state){
+        table.playRound();
+    }
+    state.SetItemsProcessed(state.iterations() * 7);
+}
+BENCHMARK(BM_GameRoundRules)->DenseRange(0, 3);
+
+//The same table with every bot sizing its bets by a policy, range(0) picks flat, kelly, ramp or martingale.
+static void BM_GameRoundBetPolicy(benchmark::State& state){
+    static const char* SPECS[] = { "flat", "kelly", "ramp", "martingale" };
+    Game table;
+    table.configureShoe(6);
+    seatBots(table, 7, SPECS[state.range(0)]);
+
+    for (auto _ : state){
+        table.playRound();
+    }
+    checkSeats(state, table, 7);
+    state.SetItemsProcessed(state.iterations() * 7);
+    state.SetLabel(SPECS[state.range(0)]);
+}
+BENCHMARK(BM_GameRoundBetPolicy)->DenseRange(0, 3);
+
+
+BENCHMARK_MAIN();
@@ -0,0 +1,162 @@
+/*
+    summarizes hand history files written with --history, without loading them: each file is memory
+    mapped and scanned a chunk at a time, and only the columns a number needs get read.
+
+    like the benchmark suite this pulls the game in whole with its main() switched off, for the file
+    format and the stats classes. build the blackjack_history target (see CMakeLists.txt) and run it
+    on one file or on all of a threaded simulation's FILE.N files at once.
+*/
+
+#define BLKJCK_NO_MAIN
+#include "OverEngineeredBlkJck.cpp"
+
+
+//Everything the summary adds up, across every file given.
+struct HistorySummary {
+    uint64_t chunks = 0;
+    uint64_t rounds = 0;
+    uint64_t dealerBusts = 0;
+    uint64_t dealerBlackjacks = 0;
+    uint64_t cards = 0;
+    uint64_t bytes = 0;
+    long long wagered = 0;
+    long long net = 0;
+    long long insuranceNet = 0;
+    long long blackjacks = 0;
+    array<long long, 4> flagged = {}; // doubled, split, surrendered, insured
+    array<long long, 4> flaggedNet = {};
+    RatioStats edge;
+    RunningStats handNet;
+    array<SeatRecord, NUMUPCARDS> upcards;
+
+    void add(const HistoryChunkView& chunk, uint64_t& lastRound){
+        chunks++;
+        for (uint32_t i = 0; i < chunk.rows; i++){
+            //Rows of a round sit together, so a new round number is a new round.
+            if (chunk.round[i] != lastRound){
+                lastRound = chunk.round[i];
+                rounds++;
+                dealerBusts += (chunk.flags[i] & HISTORY_DEALER_BUSTED) != 0;
+                dealerBlackjacks += (chunk.flags[i] & HISTORY_DEALER_BLACKJACK) != 0;
+            }
+
+            //Insurance goes in as a side bet on top of the hand, the same way GameStats counts it.
+            int bet = chunk.bet[i];
+            int result = chunk.net[i];
+            int insured = chunk.insurance[i];
+            int insuranceCost = insured < 0 ? -insured : insured / 2;
+            wagered += bet + insuranceCost;
+            net += result + insured;
+            insuranceNet += insured;
+            edge.add(result, bet);
+            handNet.add(result);
+
+            uint8_t flags = chunk.flags[i];
+            blackjacks += (flags & HISTORY_BLACKJACK) != 0;
+            for (int f = 0; f < 4; f++){
+                if (flags & (1 << f)){
+                    flagged[f]++;
+                    flaggedNet[f] += f == 3 ? insured : result;
+                }
+            }
+
+            //forEachChunk() has already turned down any chunk with an upcard outside 2 to 11.
+            SeatRecord& up = upcards[chunk.upcard[i] - 2];
+            up.wagered += bet;
+            up.net += result;
+            (result > 0 ? up.wins : result < 0 ? up.losses : up.pushes)++;
+        }
+        if (chunk.rows){
+            cards += chunk.playerCardEnd[chunk.rows - 1];
+        }
+    }
+
+    void report(double seconds) const{
+        long long hands = handNet.count();
+        cout << "\n===== HAND HISTORY =====\n";
+        cout << "Chunks:         " << chunks << endl;
+        cout << "Rounds:         " << rounds << endl;
+        cout << "Hands:          " << hands << endl;
+        cout << "Total wagered:  $" << wagered << endl;
+        cout << "Players net:    $" << net << " ($" << insuranceNet << " of it insurance)\n";
+        cout << "House edge:     " << fixed << setprecision(3) << (wagered ? -static_cast<double>(net) / wagered * 100.0 : 0.0)
+             << "%, hands alone " << -edge.ratio() * 100.0 << "% +/- " << edge.margin95() * 100.0 << "% (95%)\n";
+        cout << "Per hand:       $" << handNet.mean() << " +/- $" << handNet.margin95() << ", std dev $" << handNet.stddev() << endl;
+        cout << "Cards a hand:   " << setprecision(2) << (hands ? static_cast<double>(cards) / hands : 0.0) << endl;
+        cout << "Blackjacks:     " << blackjacks << endl;
+        cout << "Dealer:         " << setprecision(2) << (rounds ? dealerBusts * 100.0 / rounds : 0.0) << "% busts, "
+             << (rounds ? dealerBlackjacks * 100.0 / rounds : 0.0) << "% blackjacks\n";
+
+        static const char* FLAGNAMES[4] = {"Doubled", "Split", "Surrendered", "Insured"};
+        cout << setw(16) << left << "\nDecision" << setw(14) << right << "Hands" << setw(16) << "Net" << endl;
+        for (int f = 0; f < 4; f++){
+            cout << setw(15) << left << FLAGNAMES[f] << setw(14) << right << flagged[f] << setw(16) << flaggedNet[f] << endl;
+        }
+
+        cout << setw(8) << left << "\nUpcard" << setw(14) << right << "Hands" << setw(14) << "Wins"
+             << setw(14) << "Losses" << setw(14) << "Pushes" << setw(16) << "Player edge" << endl;
+        for (int i = 0; i < NUMUPCARDS; i++){
+            const SeatRecord& up = upcards[i];
+            cout << setw(7) << left << (i == NUMUPCARDS - 1 ? string("A") : to_string(i + 2))
+                 << setw(14) << right << up.wins + up.losses + up.pushes << setw(14) << up.wins
+                 << setw(14) << up.losses << setw(14) << up.pushes << setw(15) << fixed << setprecision(2)
+                 << (up.wagered ? static_cast<double>(up.net) / up.wagered * 100.0 : 0.0) << "%" << endl;
+        }
+
+        cout << "\nScanned " << bytes << " bytes in " << setprecision(3) << seconds << " s";
+        if (seconds > 0.0){
+            cout << " (" << setprecision(0) << bytes / seconds / 1e6 << " MB/s, " << hands / seconds << " hands/s)";
+        }
+        cout << endl;
+    }
+};
+
+static TableRules rulesFrom(const HistoryFileHeader& header){
+    TableRules rules;
+    rules.numDecks = static_cast<int>(header.numDecks);
+    rules.hitSoft17 = header.rules[0];
+    rules.blackjackPays = static_cast<BlackjackPayout>(header.rules[1]);
+    rules.doubleOn = static_cast<DoubleRule>(header.rules[2]);
+    rules.doubleAfterSplit = header.rules[3];
+    rules.maxHands = header.rules[4];
+    rules.lateSurrender = header.rules[5];
+    return rules;
+}
+
+
+int main(int argc, char* argv[]){
+    if (argc < 2){
+        cout << "Usage: " << argv[0] << " FILE [FILE...]\n"
+             << "  summarizes hand histories written by blackjack --history, all the files together\n";
+        return 1;
+    }
+
+    HistorySummary summary;
+    auto start = chrono::steady_clock::now();
+    for (int i = 1; i < argc; i++){
+        HandHistoryReader reader;
+        if (!reader.open(argv[i])){
+            cout << "Couldn't read " << argv[i] << ": " << reader.error() << endl;
+            return 1;
+        }
+        const HistoryFileHeader& header = reader.header();
+        cout << argv[i] << ": seed " << header.seed << " stream " << header.stream << ", "
+             << rulesFrom(header).describe() << endl;
+        if (header.rows == 0){
+            cout << "  (the writer never closed it, reading what made it to disk)\n";
+        }
+
+        uint64_t lastRound = 0;
+        bool ok = reader.forEachChunk([&summary, &lastRound](const HistoryChunkView& chunk){
+            summary.add(chunk, lastRound);
+        });
+        summary.bytes += reader.fileSize();
+        if (!ok){
+            cout << "  stopped early: " << reader.error() << endl;
+        }
+    }
+    auto stop = chrono::steady_clock::now();
+
+    summary.report(chrono::duration<double>(stop - start).count());
+    return 0;
+}